@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "analysis.h"
+
+#define ANALYSIS_HASH_MB 64
+#define ANALYSIS_REPORT_MS 250
+
+// Writes "+0.35 d12  e4 e5 Nf3 ..." with the score from the lowercase side's
+// point of view, cut short at the end of the buffer
+void analysis_format_line(const Position* root, const SearchResult* line, char* text, int size) {
+    int score = root->side == SIDE_WHITE ? line->score : -line->score;
+    int length;
+    if (score >= SCORE_MATE_IN_MAX) {
+        length = snprintf(text, size, "M%d d%d ", (SCORE_MATE - score + 1) / 2, line->depth);
+    } else if (score <= -SCORE_MATE_IN_MAX) {
+        length = snprintf(text, size, "-M%d d%d ", (SCORE_MATE + score + 1) / 2, line->depth);
+    } else {
+        length = snprintf(text, size, "%+.2f d%d ", score / 100.0, line->depth);
+    }
+
+    Position pos = *root;
+    for (int i = 0; i < line->pvLength && length < size; i++) {
+        char san[16];
+        move_to_san(&pos, line->pv[i], san);
+        if (length + (int)strlen(san) + 2 >= size || !make_move(&pos, line->pv[i])) {
+            break;
+        }
+        length += snprintf(text + length, size - length, " %s", san);
+    }
+}
+
+static void publish(const SearchContext* ctx, void* data) {
+    Analysis* analysis = data;
+    AnalysisSnapshot* snapshot = &analysis->snapshot;
+
+    // Format outside the lock, then swap the finished text in. Partway
+    // through an iteration the first lines are one ply deeper than the rest;
+    // each line shows its own depth and the header the one all have reached.
+    char text[MAX_MULTI_PV][ANALYSIS_TEXT];
+    int scores[MAX_MULTI_PV];
+    int depth = ctx->lineCount > 0 ? ctx->lines[0].depth : 0;
+    for (int i = 0; i < ctx->lineCount; i++) {
+        analysis_format_line(&analysis->root, &ctx->lines[i], text[i], ANALYSIS_TEXT);
+        scores[i] = analysis->root.side == SIDE_WHITE ? ctx->lines[i].score : -ctx->lines[i].score;
+        if (ctx->lines[i].depth < depth) {
+            depth = ctx->lines[i].depth;
+        }
+    }
+
+    SDL_LockMutex(analysis->lock);
+    snapshot->lineCount = ctx->lineCount;
+    snapshot->depth = depth;
+    snapshot->nodes = ctx->stats.nodes;
+    snapshot->elapsed = search_elapsed_ms(ctx);
+    memcpy(snapshot->scores, scores, sizeof(int) * ctx->lineCount);
+    memcpy(snapshot->text, text, sizeof(text[0]) * ctx->lineCount);
+    snapshot->generation++;
+    SDL_UnlockMutex(analysis->lock);
+    if (analysis->onUpdate) {
+        analysis->onUpdate();
+    }
+}
+
+static int analysis_thread(void* data) {
+    Analysis* analysis = data;
+    SearchLimits limits = {0};
+    limits.multiPv = analysis->lines;
+
+    SearchResult result;
+    search_init(analysis->ctx, &analysis->root);
+    analysis->ctx->tt = analysis->tt.entries ? &analysis->tt : NULL;
+    analysis->ctx->stopSignal = &analysis->stop;
+    analysis->ctx->report = publish;
+    analysis->ctx->reportData = analysis;
+    analysis->ctx->reportInterval = ANALYSIS_REPORT_MS;
+    search_position(analysis->ctx, &limits, &result);
+    return 0;
+}
+
+bool analysis_start(Analysis* analysis, char board[8][8], char turn, int lines) {
+    analysis_stop(analysis);
+
+    if (!analysis->lock) {
+        analysis->lock = SDL_CreateMutex();
+        analysis->ctx = calloc(1, sizeof(SearchContext));
+        if (!analysis->lock || !analysis->ctx) {
+            printf("Error starting analysis: %s\n", SDL_GetError());
+            analysis_free(analysis);
+            return false;
+        }
+        // Without the table the search still works, only without reuse
+        tt_init(&analysis->tt, ANALYSIS_HASH_MB);
+    }
+
+    position_set_board(&analysis->root, board, turn);
+    analysis->lines = lines;
+
+    SDL_LockMutex(analysis->lock);
+    int generation = analysis->snapshot.generation;
+    memset(&analysis->snapshot, 0, sizeof(analysis->snapshot));
+    analysis->snapshot.generation = generation + 1;
+    SDL_UnlockMutex(analysis->lock);
+
+    SDL_AtomicSet(&analysis->stop, 0);
+    analysis->thread = SDL_CreateThread(analysis_thread, "analysis", analysis);
+    if (!analysis->thread) {
+        printf("Error creating analysis thread: %s\n", SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+void analysis_stop(Analysis* analysis) {
+    if (analysis->thread) {
+        SDL_AtomicSet(&analysis->stop, 1);
+        SDL_WaitThread(analysis->thread, NULL);
+        analysis->thread = NULL;
+    }
+}
+
+bool analysis_running(const Analysis* analysis) {
+    return analysis->thread != NULL;
+}
+
+void analysis_snapshot(Analysis* analysis, AnalysisSnapshot* out) {
+    if (!analysis->lock) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    SDL_LockMutex(analysis->lock);
+    *out = analysis->snapshot;
+    SDL_UnlockMutex(analysis->lock);
+}
+
+// Reads the search counters as they stand, without waiting on the search
+void analysis_stats(const Analysis* analysis, SearchStats* stats) {
+    if (!analysis->ctx) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    search_read_stats(analysis->ctx, stats);
+}
+
+void analysis_free(Analysis* analysis) {
+    analysis_stop(analysis);
+    if (analysis->lock) {
+        SDL_DestroyMutex(analysis->lock);
+        analysis->lock = NULL;
+    }
+    free(analysis->ctx);
+    analysis->ctx = NULL;
+    tt_free(&analysis->tt);
+}
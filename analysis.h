@@ -0,0 +1,47 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <SDL2/SDL.h>
+#include "engine.h"
+#include "search.h"
+#include "tt.h"
+
+#define ANALYSIS_DEFAULT_LINES 3
+#define ANALYSIS_TEXT 160
+
+// What the panel shows, copied out under the lock so drawing never waits on
+// the search. Scores are from the lowercase (white) side's point of view.
+typedef struct {
+    int generation;         // bumped on every update
+    int lineCount;
+    int depth;              // depth every line has completed
+    uint64_t nodes;
+    int elapsed;            // milliseconds
+    int scores[MAX_MULTI_PV];
+    char text[MAX_MULTI_PV][ANALYSIS_TEXT]; // "+0.35 d12  e4 e5 Nf3"
+} AnalysisSnapshot;
+
+// Infinite multi-PV search of one position on a background thread. The
+// transposition table lives as long as the Analysis, so analysing the next
+// position after a move starts from what was learned on the last one.
+typedef struct {
+    SDL_Thread* thread;
+    SDL_mutex* lock;
+    SDL_atomic_t stop;
+    void (*onUpdate)(void); // optional, called on the search thread after each update
+    SearchContext* ctx;
+    TransTable tt;
+    Position root;
+    int lines;
+    AnalysisSnapshot snapshot;
+} Analysis;
+
+bool analysis_start(Analysis* analysis, char board[8][8], char turn, int lines);
+void analysis_stop(Analysis* analysis);
+bool analysis_running(const Analysis* analysis);
+void analysis_snapshot(Analysis* analysis, AnalysisSnapshot* out);
+void analysis_stats(const Analysis* analysis, SearchStats* stats);
+void analysis_free(Analysis* analysis);
+void analysis_format_line(const Position* root, const SearchResult* line, char* text, int size);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include "engine.h"
+#include "mapfile.h"
+
+// Opening books in the Polyglot .bin layout: 16-byte big-endian entries of
+// position key, move, weight and learn data, sorted by key. The file is
+// mapped, never read into memory, and looked up by binary search, so a book
+// of any size opens at once and a lookup allocates nothing.
+//
+// Keys are Polyglot's, from its published random numbers with the castling
+// rights included, so books from other tools and books built here read the
+// same way.
+
+#define BOOK_DEFAULT_FILE "book.bin"
+#define BOOK_ENTRY_SIZE 16
+#define MAX_BOOK_MOVES 32
+
+typedef struct {
+    MappedFile file;
+    uint64_t count;         // entries
+} Book;
+
+typedef struct {
+    Move move;
+    int weight;
+} BookMove;
+
+void book_init(void);
+bool book_open(Book* book, const char* path);
+void book_close(Book* book);
+bool book_is_open(const Book* book);
+uint64_t book_key(const Position* pos);
+int book_encode_move(Move move);
+int book_probe(const Book* book, Position* pos, BookMove* moves, int maxMoves);
+bool book_pick(const Book* book, Position* pos, Move* move);
+void book_format_moves(Position* pos, const BookMove* moves, int count, char* text, int size);
+
+// bookgen.c: builds a book from a PGN collection
+typedef struct {
+    int maxPlies;           // plies of each game that go into the book
+    int threads;
+    int memoryMB;           // bound on the position table before it spills
+    int minGames;           // moves played in fewer games are left out
+} BookBuildOptions;
+
+bool book_build(const char* pgnPath, const char* bookPath, const BookBuildOptions* options);
+
+#endif
@@ -0,0 +1,590 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <SDL2/SDL.h>
+#include "book.h"
+
+// Builds a Polyglot book from a PGN file in one streaming pass.
+//
+// The reader thread cuts the file into batches of whole games while worker
+// threads replay the previous batch. Every (position, move) pair goes into a
+// table split into shards by the top bits of the position key, so a shard
+// holds one slice of the key range and has its own lock. A shard that fills
+// up sorts itself and spills to a run file, which keeps memory bounded for
+// any number of games. At the end each shard merges its runs with what is
+// left in memory, and since shards are key ranges, writing them one after
+// the other gives a sorted book.
+
+#define SHARD_BITS 8
+#define SHARD_COUNT (1 << SHARD_BITS)
+#define BATCH_BYTES (8 << 20)
+#define BATCH_GAMES 16384
+#define MAX_GAME_BYTES (1 << 20)
+#define MAX_KEY_MOVES 256
+
+typedef struct {
+    uint64_t key;
+    uint32_t games;
+    uint32_t points;        // 2 per win and 1 per draw for the side that moved
+    uint16_t move;          // Polyglot encoding
+} BookRecord;
+
+typedef struct {
+    SDL_mutex* lock;
+    BookRecord* records;    // open addressing, games == 0 when empty
+    int capacity;
+    int count;
+    int runs;               // spilled run files
+} BookShard;
+
+typedef struct {
+    char* text;             // games, each NUL-terminated
+    size_t used;
+    size_t offsets[BATCH_GAMES];
+    int count;
+} GameBatch;
+
+typedef struct {
+    FILE* file;
+    char line[4096];
+    bool haveLine;          // line holds the first line of the next game
+    char* game;
+    size_t gameLength;
+    size_t gameSize;
+} PgnReader;
+
+typedef struct {
+    const BookBuildOptions* options;
+    const char* bookPath;
+    BookShard shards[SHARD_COUNT];
+    bool failed;
+} BookBuilder;
+
+typedef struct {
+    BookBuilder* builder;
+    const GameBatch* batch;
+    int index;
+    int stride;
+    Position pos;
+    uint64_t games;
+    uint64_t positions;
+} BookWorker;
+
+static void run_path(const BookBuilder* b, int shard, int run, char* path, int size) {
+    snprintf(path, size, "%s.%03d.%d.run", b->bookPath, shard, run);
+}
+
+static int compare_records(const void* a, const void* b) {
+    const BookRecord* x = a;
+    const BookRecord* y = b;
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    return (int)x->move - (int)y->move;
+}
+
+// Sorts the occupied records to the front of the shard; returns their count
+static int sort_shard(BookShard* shard) {
+    int count = 0;
+    for (int i = 0; i < shard->capacity; i++) {
+        if (shard->records[i].games) {
+            shard->records[count++] = shard->records[i];
+        }
+    }
+    qsort(shard->records, count, sizeof(BookRecord), compare_records);
+    return count;
+}
+
+// Writes the shard out as a sorted run and empties it. Called with the
+// shard locked.
+static void spill_shard(BookBuilder* b, int index) {
+    BookShard* shard = &b->shards[index];
+    int count = sort_shard(shard);
+    char path[512];
+    run_path(b, index, shard->runs, path, sizeof(path));
+    FILE* file = fopen(path, "wb");
+    if (!file || fwrite(shard->records, sizeof(BookRecord), count, file) != (size_t)count) {
+        printf("Error writing %s\n", path);
+        b->failed = true;
+    }
+    if (file) {
+        fclose(file);
+    }
+    shard->runs++;
+    memset(shard->records, 0, sizeof(BookRecord) * shard->capacity);
+    shard->count = 0;
+}
+
+static void add_record(BookBuilder* b, uint64_t key, int move, int points) {
+    int index = (int)(key >> (64 - SHARD_BITS));
+    BookShard* shard = &b->shards[index];
+    uint64_t hash = (key ^ ((uint64_t)move * 0x9E3779B97F4A7C15ULL)) * 0xBF58476D1CE4E5B9ULL;
+    int mask = shard->capacity - 1;
+
+    SDL_LockMutex(shard->lock);
+    int slot = (int)(hash >> 32) & mask;
+    while (shard->records[slot].games && (shard->records[slot].key != key || shard->records[slot].move != move)) {
+        slot = (slot + 1) & mask;
+    }
+    BookRecord* record = &shard->records[slot];
+    if (!record->games) {
+        record->key = key;
+        record->move = (uint16_t)move;
+        shard->count++;
+    }
+    record->games++;
+    record->points += points;
+    // Three quarters full keeps the probe sequences short
+    if (shard->count >= shard->capacity / 4 * 3) {
+        spill_shard(b, index);
+    }
+    SDL_UnlockMutex(shard->lock);
+}
+
+// Copies the next game, tags and moves, into reader->game; false at the end
+// of the file. A game ends where the next one's tags begin.
+static bool next_game(PgnReader* r) {
+    r->gameLength = 0;
+    bool inMoves = false;
+    for (;;) {
+        if (!r->haveLine && !fgets(r->line, sizeof(r->line), r->file)) {
+            break;
+        }
+        r->haveLine = false;
+        bool tag = r->line[0] == '[';
+        if (tag && inMoves) {
+            r->haveLine = true;
+            break;
+        }
+        if (!tag && r->line[strspn(r->line, " \t\r\n")] != '\0') {
+            inMoves = true;
+        }
+
+        size_t length = strlen(r->line);
+        if (r->gameLength + length + 1 > r->gameSize) {
+            if (r->gameSize >= MAX_GAME_BYTES) {
+                continue;       // the rest of an oversized game is dropped
+            }
+            size_t size = r->gameSize ? r->gameSize * 2 : 4096;
+            char* game = realloc(r->game, size);
+            if (!game) {
+                continue;
+            }
+            r->game = game;
+            r->gameSize = size;
+        }
+        memcpy(r->game + r->gameLength, r->line, length);
+        r->gameLength += length;
+    }
+    if (r->gameLength == 0) {
+        return false;
+    }
+    r->game[r->gameLength] = '\0';
+    return true;
+}
+
+// Fills a batch with whole games; false when there were none left
+static bool read_batch(PgnReader* r, GameBatch* batch, bool* pending) {
+    batch->used = 0;
+    batch->count = 0;
+    while (batch->count < BATCH_GAMES) {
+        if (!*pending && !next_game(r)) {
+            break;
+        }
+        *pending = true;
+        if (batch->used + r->gameLength + 1 > BATCH_BYTES) {
+            if (batch->count > 0) {
+                break;          // starts the next batch
+            }
+            *pending = false;   // never fits, skip it
+            continue;
+        }
+        batch->offsets[batch->count++] = batch->used;
+        memcpy(batch->text + batch->used, r->game, r->gameLength + 1);
+        batch->used += r->gameLength + 1;
+        *pending = false;
+    }
+    return batch->count > 0;
+}
+
+// Value of a tag, "" when the game has none
+static void tag_value(const char* game, const char* name, char* value, int size) {
+    value[0] = '\0';
+    char pattern[32];
+    snprintf(pattern, sizeof(pattern), "[%s \"", name);
+    const char* start = strstr(game, pattern);
+    if (!start) {
+        return;
+    }
+    start += strlen(pattern);
+    const char* end = strchr(start, '"');
+    int length = end ? (int)(end - start) : 0;
+    if (length >= size) {
+        length = size - 1;
+    }
+    memcpy(value, start, length);
+    value[length] = '\0';
+}
+
+// Replays one game's moves up to the ply limit and records every move with
+// the points its side scored
+static void add_game(BookWorker* w, const char* game) {
+    char result[16];
+    tag_value(game, "Result", result, sizeof(result));
+    int whitePoints;
+    if (strcmp(result, "1-0") == 0) {
+        whitePoints = 2;
+    } else if (strcmp(result, "0-1") == 0) {
+        whitePoints = 0;
+    } else if (strcmp(result, "1/2-1/2") == 0) {
+        whitePoints = 1;
+    } else {
+        return;                 // unfinished games say nothing about the moves
+    }
+
+    char fen[128];
+    tag_value(game, "FEN", fen, sizeof(fen));
+    Position* pos = &w->pos;
+    if (!position_set_fen(pos, fen[0] ? fen : "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w - - 0 1")) {
+        return;
+    }
+    w->games++;
+
+    // Movetext starts after the last tag line
+    const char* c = game;
+    for (const char* tag; (tag = strstr(c, "\n[")) != NULL; c = tag + 1) {
+    }
+    if (*c == '[') {
+        c = strchr(c, '\n');
+    }
+
+    int depth = 0;              // nesting of variations
+    for (int ply = 0; c && *c && ply < w->builder->options->maxPlies;) {
+        if (isspace((unsigned char)*c)) {
+            c++;
+            continue;
+        }
+        if (*c == '{') {
+            c = strchr(c, '}');
+            c = c ? c + 1 : NULL;
+            continue;
+        }
+        if (*c == ';') {
+            c = strchr(c, '\n');
+            continue;
+        }
+        if (*c == '(' || *c == ')') {
+            depth += *c == '(' ? 1 : -1;
+            c++;
+            continue;
+        }
+
+        char token[32];
+        int length = 0;
+        while (c[length] && !isspace((unsigned char)c[length]) && !strchr("{;()", c[length])) {
+            length++;
+        }
+        int copy = length < (int)sizeof(token) - 1 ? length : (int)sizeof(token) - 1;
+        memcpy(token, c, copy);
+        token[copy] = '\0';
+        c += length;
+        if (depth > 0 || token[0] == '$') {
+            continue;
+        }
+        // Move numbers ("12." and "12...") may run into the move itself
+        const char* san = token;
+        while (isdigit((unsigned char)*san)) {
+            san++;
+        }
+        if (*san == '.') {
+            while (*san == '.') {
+                san++;
+            }
+        } else {
+            san = token;
+        }
+        // Annotations such as "!?" are not part of the move
+        char* end = token + strlen(token);
+        while (end > san && (end[-1] == '!' || end[-1] == '?')) {
+            *--end = '\0';
+        }
+        if (*san == '\0') {
+            continue;
+        }
+        if (strcmp(san, "1-0") == 0 || strcmp(san, "0-1") == 0 || strcmp(san, "1/2-1/2") == 0 || strcmp(san, "*") == 0) {
+            break;
+        }
+
+        // The game leaves the book at the first move these rules reject
+        Move move = parse_san(pos, san);
+        if (move_is_none(move)) {
+            break;
+        }
+        int points = pos->side == SIDE_WHITE ? whitePoints : 2 - whitePoints;
+        add_record(w->builder, book_key(pos), book_encode_move(move), points);
+        w->positions++;
+        make_move(pos, move);
+        ply++;
+    }
+}
+
+static int replay_games(void* data) {
+    BookWorker* w = data;
+    for (int i = w->index; i < w->batch->count; i += w->stride) {
+        add_game(w, w->batch->text + w->batch->offsets[i]);
+    }
+    return 0;
+}
+
+// One sorted source in the merge: a run file or the shard's memory
+typedef struct {
+    FILE* file;
+    const BookRecord* records;
+    int count;
+    int next;
+    BookRecord head;
+    bool done;
+} RunSource;
+
+static void advance(RunSource* s) {
+    if (s->file) {
+        s->done = fread(&s->head, sizeof(BookRecord), 1, s->file) != 1;
+    } else {
+        s->done = s->next >= s->count;
+        if (!s->done) {
+            s->head = s->records[s->next++];
+        }
+    }
+}
+
+static void write_be(FILE* file, uint64_t value, int length) {
+    uint8_t bytes[8];
+    for (int i = length - 1; i >= 0; i--) {
+        bytes[i] = (uint8_t)value;
+        value >>= 8;
+    }
+    fwrite(bytes, 1, length, file);
+}
+
+static int compare_weights(const void* a, const void* b) {
+    const BookRecord* x = a;
+    const BookRecord* y = b;
+    return (int)y->points - (int)x->points;
+}
+
+// Writes one position's moves, best first, with the weights scaled into
+// Polyglot's 16 bits; returns the entries written
+static int write_key(FILE* out, BookRecord* moves, int count, int minGames) {
+    uint32_t most = 0;
+    for (int i = 0; i < count; i++) {
+        most = moves[i].points > most ? moves[i].points : most;
+    }
+    qsort(moves, count, sizeof(BookRecord), compare_weights);
+    int written = 0;
+    for (int i = 0; i < count; i++) {
+        uint64_t weight = most > 65535 ? (uint64_t)moves[i].points * 65535 / most : moves[i].points;
+        if (moves[i].games < (uint32_t)minGames || weight == 0) {
+            continue;
+        }
+        write_be(out, moves[i].key, 8);
+        write_be(out, moves[i].move, 2);
+        write_be(out, weight, 2);
+        write_be(out, 0, 4);
+        written++;
+    }
+    return written;
+}
+
+// Merges a shard's runs and remaining records into the book
+static uint64_t merge_shard(BookBuilder* b, int index, FILE* out) {
+    BookShard* shard = &b->shards[index];
+    int sourceCount = shard->runs + 1;
+    RunSource* sources = calloc(sourceCount, sizeof(RunSource));
+    if (!sources) {
+        b->failed = true;
+        return 0;
+    }
+    for (int i = 0; i < shard->runs; i++) {
+        char path[512];
+        run_path(b, index, i, path, sizeof(path));
+        sources[i].file = fopen(path, "rb");
+        if (!sources[i].file) {
+            printf("Error reading %s\n", path);
+            b->failed = true;
+        }
+    }
+    sources[shard->runs].records = shard->records;
+    sources[shard->runs].count = sort_shard(shard);
+    for (int i = 0; i < sourceCount; i++) {
+        advance(&sources[i]);
+    }
+
+    // Runs per shard stay few, so the smallest head is found by a scan
+    static BookRecord moves[MAX_KEY_MOVES];
+    int moveCount = 0;
+    uint64_t written = 0;
+    for (;;) {
+        int smallest = -1;
+        for (int i = 0; i < sourceCount; i++) {
+            if (!sources[i].done && (smallest < 0 || compare_records(&sources[i].head, &sources[smallest].head) < 0)) {
+                smallest = i;
+            }
+        }
+        if (smallest < 0) {
+            break;
+        }
+        BookRecord record = sources[smallest].head;
+        advance(&sources[smallest]);
+
+        if (moveCount > 0 && moves[moveCount - 1].key != record.key) {
+            written += write_key(out, moves, moveCount, b->options->minGames);
+            moveCount = 0;
+        }
+        if (moveCount > 0 && moves[moveCount - 1].move == record.move) {
+            moves[moveCount - 1].games += record.games;
+            moves[moveCount - 1].points += record.points;
+        } else if (moveCount < MAX_KEY_MOVES) {
+            moves[moveCount++] = record;
+        }
+    }
+    if (moveCount > 0) {
+        written += write_key(out, moves, moveCount, b->options->minGames);
+    }
+
+    for (int i = 0; i < shard->runs; i++) {
+        if (sources[i].file) {
+            fclose(sources[i].file);
+        }
+        char path[512];
+        run_path(b, index, i, path, sizeof(path));
+        remove(path);
+    }
+    free(sources);
+    return written;
+}
+
+// Starts one thread per worker on a batch; they are joined by wait_workers
+static void start_workers(BookWorker* workers, int count, const GameBatch* batch, SDL_Thread** threads) {
+    for (int t = 0; t < count; t++) {
+        workers[t].batch = batch;
+        threads[t] = SDL_CreateThread(replay_games, "bookgen", &workers[t]);
+        if (!threads[t]) {
+            replay_games(&workers[t]);
+        }
+    }
+}
+
+static void wait_workers(int count, SDL_Thread** threads) {
+    for (int t = 0; t < count; t++) {
+        if (threads[t]) {
+            SDL_WaitThread(threads[t], NULL);
+            threads[t] = NULL;
+        }
+    }
+}
+
+bool book_build(const char* pgnPath, const char* bookPath, const BookBuildOptions* options) {
+    engine_init();
+    book_init();
+    PgnReader reader = {0};
+    reader.file = fopen(pgnPath, "r");
+    if (!reader.file) {
+        printf("Error opening %s\n", pgnPath);
+        return false;
+    }
+
+    int threads = options->threads < 1 ? 1 : (options->threads > 64 ? 64 : options->threads);
+    BookBuilder* b = calloc(1, sizeof(BookBuilder));
+    BookWorker* workers = calloc(threads, sizeof(BookWorker));
+    GameBatch* batches = calloc(2, sizeof(GameBatch));
+    SDL_Thread* running[64] = {NULL};
+
+    // The shard tables share the memory budget, each a power of two
+    size_t perShard = ((size_t)options->memoryMB << 20) / SHARD_COUNT / sizeof(BookRecord);
+    int capacity = 1024;
+    while ((size_t)capacity * 2 <= perShard) {
+        capacity *= 2;
+    }
+    bool ok = b && workers && batches;
+    for (int i = 0; ok && i < 2; i++) {
+        batches[i].text = malloc(BATCH_BYTES);
+        ok = batches[i].text != NULL;
+    }
+    for (int i = 0; ok && i < SHARD_COUNT; i++) {
+        b->shards[i].lock = SDL_CreateMutex();
+        b->shards[i].records = calloc(capacity, sizeof(BookRecord));
+        b->shards[i].capacity = capacity;
+        ok = b->shards[i].lock && b->shards[i].records;
+    }
+    if (!ok) {
+        printf("Error allocating the book tables\n");
+    }
+
+    uint64_t start = SDL_GetPerformanceCounter();
+    uint64_t games = 0, positions = 0, entries = 0;
+    int runs = 0;
+    if (ok) {
+        b->options = options;
+        b->bookPath = bookPath;
+        for (int t = 0; t < threads; t++) {
+            workers[t].builder = b;
+            workers[t].index = t;
+            workers[t].stride = threads;
+        }
+
+        // Reading the next batch overlaps with replaying the current one
+        bool pending = false;
+        int current = 0;
+        bool more = read_batch(&reader, &batches[current], &pending);
+        while (more) {
+            start_workers(workers, threads, &batches[current], running);
+            more = read_batch(&reader, &batches[1 - current], &pending);
+            wait_workers(threads, running);
+            current = 1 - current;
+        }
+        for (int t = 0; t < threads; t++) {
+            games += workers[t].games;
+            positions += workers[t].positions;
+        }
+
+        FILE* out = fopen(bookPath, "wb");
+        if (!out) {
+            printf("Error creating %s\n", bookPath);
+            ok = false;
+        }
+        for (int i = 0; i < SHARD_COUNT; i++) {
+            runs += b->shards[i].runs;
+            if (out) {
+                entries += merge_shard(b, i, out);
+            }
+        }
+        if (out && fclose(out) != 0) {
+            ok = false;
+        }
+        ok = ok && !b->failed;
+    }
+
+    uint64_t elapsed = (SDL_GetPerformanceCounter() - start) * 1000 / SDL_GetPerformanceFrequency();
+    printf("Games %llu, positions %llu, runs spilled %d, book entries %llu\n", (unsigned long long)games,
+           (unsigned long long)positions, runs, (unsigned long long)entries);
+    printf("Time %llu ms, %llu games/s, table memory %llu MB\n", (unsigned long long)elapsed,
+           (unsigned long long)(elapsed ? games * 1000 / elapsed : 0),
+           (unsigned long long)((size_t)capacity * SHARD_COUNT * sizeof(BookRecord) >> 20));
+
+    for (int i = 0; b && i < SHARD_COUNT; i++) {
+        if (b->shards[i].lock) {
+            SDL_DestroyMutex(b->shards[i].lock);
+        }
+        free(b->shards[i].records);
+    }
+    for (int i = 0; batches && i < 2; i++) {
+        free(batches[i].text);
+    }
+    free(batches);
+    free(workers);
+    free(b);
+    free(reader.game);
+    fclose(reader.file);
+    return ok;
+}
@@ -6,9 +6,12 @@
 #include <SDL2/SDL_ttf.h>
 #include <SDL2/SDL_mixer.h>
 #include "functions.h"
+#include "commands.h"
+#include "tb.h"
+#include "book.h"
+#include "text.h"
+#include "resources.h"
 
-#define WINDOW_WIDTH 800
-#define WINDOW_HEIGHT 640
 #define BOARD_SIZE 8
 
 // Define player colors
@@ -18,16 +21,22 @@
 char turn = BLACK; // Start with white player
 
 int main(int argc, char* argv[]) {
+    // Engine commands (chess epd ...) run headless, without a window
+    if (argc > 1) {
+        return run_command(argc - 1, argv + 1);
+    }
+
     // Initialize TTF
     TTF_Init();
 
-    SDL_Window* window = create_window("Chess", WINDOW_WIDTH, WINDOW_HEIGHT);
+    SDL_Window* window = create_window("Chess", BASE_WIDTH, BASE_HEIGHT);
     if (!window) {
         return 1;
     }
 
-    // Create a renderer and check for errors
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    // Create a renderer and check for errors. Presents wait for vsync, which
+    // paces animation frames to the display.
+    SDL_Renderer* renderer = resource_renderer(window, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
     if (!renderer) {
         printf("Error creating renderer: %s\n", SDL_GetError());
         SDL_DestroyWindow(window);
@@ -38,7 +47,7 @@ int main(int argc, char* argv[]) {
     // Initialize SDL_image and check for errors
     if (IMG_Init(IMG_INIT_PNG) != IMG_INIT_PNG) {
         printf("Error initializing SDL_image: %s\n", IMG_GetError());
-        SDL_DestroyRenderer(renderer);
+        resource_shutdown();
         SDL_DestroyWindow(window);
         SDL_Quit();
         return 1;
@@ -55,24 +64,6 @@ int main(int argc, char* argv[]) {
     // Load sound effects
     load_sounds();
 
-
-    // Load font
-    TTF_Font* font = TTF_OpenFont("Atop-R99O3.ttf", 32);
-    if (!font) {
-        printf("Failed to load font: %s\n", TTF_GetError());
-        return 1;
-    }
-
-    TTF_Font* turn_font = TTF_OpenFont("Atop-R99O3.ttf", 15);
-    if (!font) {
-        printf("Failed to load font: %s\n", TTF_GetError());
-        return 1;
-    }
- 
-    // Load textures for the chess pieces
-    SDL_Texture* textures[12];
-    load_chess_pieces(renderer, textures);
-
     char board[8][8] = {
             {'R', 'N', 'B', 'Q', 'K', 'B', 'N', 'R'},
             {'P', 'P', 'P', 'P', 'P', 'P', 'P', 'P'},
@@ -84,27 +75,38 @@ int main(int argc, char* argv[]) {
             {'r', 'n', 'b', 'q', 'k', 'b', 'n', 'r'}
         };
 
-    if(menu_screen(font, renderer)){
-
-        game_event(renderer, turn_font, font, textures, board, window);
-
+    // Endgame tables are optional; whatever has been generated into the
+    // tables directory is used by the game and its analysis
+    tb_init(TB_DEFAULT_DIR);
+    load_opening_book(BOOK_DEFAULT_FILE);
+
+    // The menu, the game and the menus over it all run in one loop. The
+    // fonts and pieces load for the window's size as it is laid out, and
+    // the registry closes whatever did open if they fail.
+    App app = {0};
+    app.window = window;
+    app.renderer = renderer;
+    app.board = board;
+    int status = 0;
+    if (init_scenes(&app)) {
+        run_scenes(&app);
+    } else {
+        status = 1;
     }
-
-    // Clean up textures
-    for (int i = 0; i < 12; i++) {
-        if (textures[i]) {
-            SDL_DestroyTexture(textures[i]);
-        }
-    } 
-
-    // Clean up renderer and window
-   
-    TTF_CloseFont(font);
-    SDL_DestroyRenderer(renderer);
+    free_scenes(&app);
+
+    // Release everything this function took; the sweep then only finds
+    // what something else forgot, and reports it
+    free_sounds();
+    tb_free();
+    free_opening_book();
+    text_free();
+    resource_release(renderer);
+    resource_shutdown();
     SDL_DestroyWindow(window);
     IMG_Quit();
     SDL_Quit();
 
-    return 0;
+    return status;
 
 }
\ No newline at end of file
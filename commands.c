@@ -0,0 +1,844 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "commands.h"
+#include "engine.h"
+#include "search.h"
+#include "evaluate.h"
+#include "nnue.h"
+#include "tt.h"
+#include "analysis.h"
+#include "mate.h"
+#include "tb.h"
+#include "book.h"
+#include <SDL2/SDL.h>
+
+static void print_usage(void) {
+    printf("Usage:\n");
+    printf("  chess epd <file> [depth] [--json] [search options]\n");
+    printf("  chess eval [fen]\n");
+    printf("  chess nnue <network> [fen]\n");
+    printf("  chess analyze [fen] [lines] [depth] [--json] [search options]\n");
+    printf("  chess clock <ms> <increment ms> [fen] [--book <file>] [search options]\n");
+    printf("  chess bench [search depth] [perft depth]\n");
+    printf("  chess mate <fen> [max moves] [node budget]\n");
+    printf("  chess tbgen <material, e.g. KRPKR> [--dir <directory>] [--threads <count>]\n");
+    printf("  chess tbprobe <fen> [directory]\n");
+    printf("  chess book <file> [fen]\n");
+    printf("  chess bookgen <pgn> <book> [--plies <count>] [--threads <count>] [--memory <MB>] [--min-games <count>]\n");
+    printf("\nSearch options:\n");
+    printf("  --no-qsearch --no-delta --no-see --no-null --no-lmr --no-rfp --no-futility\n");
+    printf("  --time <ms> --nodes <count> --nnue <network> --tb <directory> --no-tb\n");
+    printf("  --clock <ms> --inc <ms> --movestogo <moves>\n");
+}
+
+// Applies the shared search switches; returns false for an unknown argument
+static bool parse_search_option(const char* arg, const char* next, SearchOptions* options, SearchLimits* limits, bool* usedNext) {
+    *usedNext = false;
+    if (strcmp(arg, "--no-qsearch") == 0) {
+        options->quiescence = false;
+    } else if (strcmp(arg, "--no-delta") == 0) {
+        options->deltaPruning = false;
+    } else if (strcmp(arg, "--no-see") == 0) {
+        options->seePruning = false;
+    } else if (strcmp(arg, "--no-null") == 0) {
+        options->nullMove = false;
+    } else if (strcmp(arg, "--no-lmr") == 0) {
+        options->lateMoveReductions = false;
+    } else if (strcmp(arg, "--no-rfp") == 0) {
+        options->reverseFutility = false;
+    } else if (strcmp(arg, "--no-futility") == 0) {
+        options->futility = false;
+    } else if (strcmp(arg, "--time") == 0 && next) {
+        limits->moveTime = atoi(next);
+        *usedNext = true;
+    } else if (strcmp(arg, "--nodes") == 0 && next) {
+        limits->nodes = strtoull(next, NULL, 10);
+        *usedNext = true;
+    } else if (strcmp(arg, "--clock") == 0 && next) {
+        limits->time = atoi(next);
+        *usedNext = true;
+    } else if (strcmp(arg, "--inc") == 0 && next) {
+        limits->increment = atoi(next);
+        *usedNext = true;
+    } else if (strcmp(arg, "--movestogo") == 0 && next) {
+        limits->movesToGo = atoi(next);
+        *usedNext = true;
+    } else if (strcmp(arg, "--nnue") == 0 && next) {
+        options->nnue = nnue_load(next);
+        *usedNext = true;
+    } else if (strcmp(arg, "--tb") == 0 && next) {
+        printf("Mapped %d endgame tables from %s\n", tb_init(next), next);
+        *usedNext = true;
+    } else if (strcmp(arg, "--no-tb") == 0) {
+        options->tablebases = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Copies the value of an EPD operation ("bm Qg6 Qh5;") into value
+static bool epd_operation(const char* line, const char* opcode, char* value, int size) {
+    size_t length = strlen(opcode);
+    for (const char* c = line; (c = strstr(c, opcode)) != NULL; c += length) {
+        if ((c == line || c[-1] == ' ' || c[-1] == ';') && c[length] == ' ') {
+            const char* start = c + length + 1;
+            const char* end = strchr(start, ';');
+            int n = end ? (int)(end - start) : (int)strlen(start);
+            if (n >= size) {
+                n = size - 1;
+            }
+            memcpy(value, start, n);
+            value[n] = '\0';
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool san_in_list(const char* san, const char* list) {
+    char copy[256];
+    snprintf(copy, sizeof(copy), "%s", list);
+    size_t length = strcspn(san, "+#");
+    for (char* token = strtok(copy, " "); token; token = strtok(NULL, " ")) {
+        if (strcspn(token, "+#!?") == length && strncmp(token, san, length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Writes text as a JSON string, dropping the quotes EPD puts around ids
+static void print_json_string(const char* text) {
+    size_t length = strlen(text);
+    if (length >= 2 && text[0] == '"' && text[length - 1] == '"') {
+        text++;
+        length -= 2;
+    }
+    putchar('"');
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] == '"' || text[i] == '\\') {
+            putchar('\\');
+        }
+        if ((unsigned char)text[i] >= ' ') {
+            putchar(text[i]);
+        }
+    }
+    putchar('"');
+}
+
+// The counters as JSON members, for scripts comparing builds or settings;
+// iterations lists the nodes and milliseconds spent on each depth
+static void print_stats_json(const SearchStats* stats, bool iterations) {
+    printf("\"nodes\":%llu,\"qnodes\":%llu,\"ms\":%d,\"nps\":%llu,\"ttProbes\":%llu,\"ttHits\":%llu,"
+           "\"ttHitRate\":%.2f,\"betaCutoffs\":%llu,\"firstMoveCutoffRate\":%.2f,\"tbHits\":%llu",
+           (unsigned long long)stats->nodes, (unsigned long long)stats->qnodes, stats->elapsed,
+           (unsigned long long)search_nps(stats), (unsigned long long)stats->ttProbes,
+           (unsigned long long)stats->ttHits, search_tt_hit_rate(stats), (unsigned long long)stats->betaCutoffs,
+           search_first_move_cutoff_rate(stats), (unsigned long long)stats->tbHits);
+    if (!iterations) {
+        return;
+    }
+    printf(",\"ebf\":%.3f,\"iterations\":[", search_branching_factor(stats, stats->depth));
+    for (int depth = 1; depth <= stats->depth; depth++) {
+        printf("%s{\"depth\":%d,\"nodes\":%llu,\"ms\":%d}", depth > 1 ? "," : "", depth,
+               (unsigned long long)(stats->iterationNodes[depth] - stats->iterationNodes[depth - 1]),
+               stats->iterationTime[depth] - stats->iterationTime[depth - 1]);
+    }
+    printf("]");
+}
+
+// Runs a tactical test suite and reports how many best moves were found and
+// how much of the tree the quiescence search accounts for. With --json each
+// position and the totals are one JSON object per line instead.
+static int command_epd(int argc, char* argv[]) {
+    if (argc < 2) {
+        print_usage();
+        return 1;
+    }
+
+    SearchOptions options;
+    SearchLimits limits = {0};
+    search_default_options(&options);
+    limits.depth = 6;
+    bool json = false;
+
+    for (int i = 2; i < argc; i++) {
+        bool usedNext;
+        if (parse_search_option(argv[i], i + 1 < argc ? argv[i + 1] : NULL, &options, &limits, &usedNext)) {
+            i += usedNext;
+        } else if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (atoi(argv[i]) > 0) {
+            limits.depth = atoi(argv[i]);
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    FILE* file = fopen(argv[1], "r");
+    if (!file) {
+        printf("Error opening %s\n", argv[1]);
+        return 1;
+    }
+
+    static SearchContext ctx;
+    static TransTable tt;
+    if (!tt.entries && !tt_init(&tt, TT_DEFAULT_MB)) {
+        fclose(file);
+        return 1;
+    }
+    char line[1024];
+    int total = 0, solved = 0;
+    SearchStats totals = {0};
+    double branchingSum = 0.0;
+    int branchingCount = 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        Position pos;
+        if (line[0] == '\0' || line[0] == '#' || !position_set_fen(&pos, line)) {
+            continue;
+        }
+
+        char bestMoves[256] = "", avoidMoves[256] = "", id[64] = "";
+        bool hasBest = epd_operation(line, "bm", bestMoves, sizeof(bestMoves));
+        bool hasAvoid = epd_operation(line, "am", avoidMoves, sizeof(avoidMoves));
+        epd_operation(line, "id", id, sizeof(id));
+        if (!hasBest && !hasAvoid) {
+            continue;
+        }
+
+        // Each position starts from an empty table so results do not depend
+        // on the order of the suite
+        SearchResult result;
+        search_init(&ctx, &pos);
+        ctx.options = options;
+        tt_clear(&tt);
+        ctx.tt = &tt;
+        search_position(&ctx, &limits, &result);
+
+        char san[16] = "(none)";
+        if (!move_is_none(result.bestMove)) {
+            move_to_san(&pos, result.bestMove, san);
+        }
+        bool ok = (!hasBest || san_in_list(san, bestMoves)) && (!hasAvoid || !san_in_list(san, avoidMoves));
+
+        total++;
+        solved += ok;
+        search_add_stats(&totals, &ctx.stats);
+        double branching = search_branching_factor(&ctx.stats, result.depth);
+        if (branching > 0.0) {
+            branchingSum += branching;
+            branchingCount++;
+        }
+
+        if (json) {
+            printf("{\"id\":");
+            print_json_string(id);
+            printf(",\"found\":\"%s\",\"ok\":%s,\"score\":%d,\"depth\":%d,", san, ok ? "true" : "false",
+                   result.score, result.depth);
+            print_stats_json(&ctx.stats, true);
+            printf("}\n");
+            continue;
+        }
+        printf("%-4s %-20s found %-8s expected %s%-10s score %6d depth %2d nodes %10llu qnodes %10llu ebf %.2f\n",
+               ok ? "ok" : "FAIL", id, san, hasBest ? "" : "not ", hasBest ? bestMoves : avoidMoves,
+               result.score, result.depth, (unsigned long long)ctx.stats.nodes,
+               (unsigned long long)ctx.stats.qnodes, branching);
+    }
+    fclose(file);
+
+    uint64_t nodes = totals.nodes, qnodes = totals.qnodes;
+    int elapsed = totals.elapsed;
+    if (json) {
+        printf("{\"solved\":%d,\"total\":%d,\"ebf\":%.3f,", solved, total,
+               branchingCount ? branchingSum / branchingCount : 0.0);
+        print_stats_json(&totals, false);
+        printf("}\n");
+        return 0;
+    }
+    printf("\nSolved %d of %d\n", solved, total);
+    printf("Nodes %llu, quiescence nodes %llu (%.1f%% of the tree)\n",
+           (unsigned long long)nodes, (unsigned long long)qnodes, nodes ? 100.0 * qnodes / nodes : 0.0);
+    printf("Beta cutoffs %llu, %.1f%% on the first move\n",
+           (unsigned long long)totals.betaCutoffs, search_first_move_cutoff_rate(&totals));
+    printf("Pawn hash probes %llu, %.1f%% hits\n", (unsigned long long)totals.pawnProbes,
+           totals.pawnProbes ? 100.0 * totals.pawnHits / totals.pawnProbes : 0.0);
+    printf("Transposition table probes %llu, %.1f%% hits\n", (unsigned long long)totals.ttProbes,
+           totals.ttProbes ? 100.0 * totals.ttHits / totals.ttProbes : 0.0);
+    if (tb_max_pieces() > 0) {
+        printf("Endgame table hits %llu\n", (unsigned long long)totals.tbHits);
+    }
+    printf("Effective branching factor %.2f\n", branchingCount ? branchingSum / branchingCount : 0.0);
+    printf("Time %d ms, %llu nps\n", elapsed,
+           (unsigned long long)(elapsed ? nodes * 1000 / elapsed : 0));
+    return 0;
+}
+
+// Prints the static evaluation of a position and how long one call takes
+static int command_eval(int argc, char* argv[]) {
+    const char* fen = argc > 1 ? argv[1] : "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w - - 0 1";
+    Position pos;
+    if (!position_set_fen(&pos, fen)) {
+        printf("Invalid FEN: %s\n", fen);
+        return 1;
+    }
+
+    static PawnTable pawnTable;
+    pawn_table_clear(&pawnTable);
+
+    const int iterations = 10000000;
+    volatile int sink = 0;
+    uint64_t start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < iterations; i++) {
+        // Flip the side so the call cannot be hoisted out of the loop
+        pos.side ^= 1;
+        sink += evaluate(&pos, &pawnTable);
+    }
+    uint64_t ticks = SDL_GetPerformanceCounter() - start;
+    double nanoseconds = (double)ticks * 1e9 / SDL_GetPerformanceFrequency() / iterations;
+
+    printf("Evaluation %d (side to move), middlegame %d, endgame %d, phase %d/%d\n",
+           evaluate(&pos, NULL), pos.mg, pos.eg, pos.phase, PHASE_MAX);
+    printf("%.2f ns per evaluation\n", nanoseconds);
+    return 0;
+}
+
+// Loads a network, prints its evaluation of a position and measures full
+// evaluations per second with an incremental accumulator update each time
+static int command_nnue(int argc, char* argv[]) {
+    if (argc < 2) {
+        print_usage();
+        return 1;
+    }
+    if (!nnue_load(argv[1])) {
+        return 1;
+    }
+    const char* fen = argc > 2 ? argv[2] : "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w - - 0 1";
+    Position pos;
+    if (!position_set_fen(&pos, fen)) {
+        printf("Invalid FEN: %s\n", fen);
+        return 1;
+    }
+
+    NnueAccumulator root, child;
+    nnue_refresh(&root, &pos);
+    printf("Kernel %s, evaluation %d (side to move)\n", nnue_kernel_name(), nnue_evaluate(&root, &pos));
+
+    MoveList list;
+    generate_legal_moves(&pos, &list);
+    if (list.count == 0) {
+        return 0;
+    }
+
+    const int iterations = 2000000;
+    volatile int sink = 0;
+    uint64_t start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < iterations; i++) {
+        Move move = list.moves[i % list.count];
+        make_move(&pos, move);
+        nnue_update(&child, &root, &pos, move);
+        sink += nnue_evaluate(&child, &pos);
+        unmake_move(&pos, move);
+    }
+    uint64_t ticks = SDL_GetPerformanceCounter() - start;
+    double seconds = (double)ticks / SDL_GetPerformanceFrequency();
+
+    printf("%.0f evaluations per second (update and evaluate)\n", iterations / seconds);
+    nnue_free();
+    return 0;
+}
+
+// The line just completed is the one searched with the others excluded
+static void print_line(const SearchContext* ctx, void* data) {
+    (void)data;
+    int line = ctx->excludedCount;
+    char text[ANALYSIS_TEXT];
+    analysis_format_line(&ctx->pos, &ctx->lines[line], text, sizeof(text));
+    printf("%d. %-70s nodes %10llu time %6d ms\n", line + 1, text,
+           (unsigned long long)ctx->stats.nodes, search_elapsed_ms(ctx));
+}
+
+// Multi-PV analysis of one position, printing the lines as they complete,
+// or with --json only the result and its counters once the search ends
+static int command_analyze(int argc, char* argv[]) {
+    const char* fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w - - 0 1";
+    SearchOptions options;
+    SearchLimits limits = {0};
+    search_default_options(&options);
+    limits.multiPv = ANALYSIS_DEFAULT_LINES;
+    limits.depth = 10;
+    bool json = false;
+
+    int numbers = 0;
+    for (int i = 1; i < argc; i++) {
+        bool usedNext;
+        if (parse_search_option(argv[i], i + 1 < argc ? argv[i + 1] : NULL, &options, &limits, &usedNext)) {
+            i += usedNext;
+        } else if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (atoi(argv[i]) > 0 && strchr(argv[i], '/') == NULL) {
+            // Line count first, then depth
+            if (numbers++ == 0) {
+                limits.multiPv = atoi(argv[i]);
+            } else {
+                limits.depth = atoi(argv[i]);
+            }
+        } else {
+            fen = argv[i];
+        }
+    }
+
+    Position pos;
+    if (!position_set_fen(&pos, fen)) {
+        printf("Invalid FEN: %s\n", fen);
+        return 1;
+    }
+
+    static SearchContext ctx;
+    static TransTable tt;
+    if (!tt_init(&tt, TT_DEFAULT_MB)) {
+        return 1;
+    }
+    SearchResult result;
+    search_init(&ctx, &pos);
+    ctx.options = options;
+    ctx.tt = &tt;
+    ctx.report = json ? NULL : print_line;
+    search_position(&ctx, &limits, &result);
+
+    if (json) {
+        char uci[8] = "";
+        if (!move_is_none(result.bestMove)) {
+            move_to_uci(result.bestMove, uci);
+        }
+        printf("{\"fen\":");
+        print_json_string(fen);
+        printf(",\"bestmove\":\"%s\",\"score\":%d,\"depth\":%d,", uci, result.score, result.depth);
+        print_stats_json(&ctx.stats, true);
+        printf("}\n");
+        tt_free(&tt);
+        return 0;
+    }
+    printf("Transposition table probes %llu, %.1f%% hits\n", (unsigned long long)ctx.stats.ttProbes,
+           ctx.stats.ttProbes ? 100.0 * ctx.stats.ttHits / ctx.stats.ttProbes : 0.0);
+    if (ctx.options.tablebases) {
+        printf("Endgame table hits %llu\n", (unsigned long long)ctx.stats.tbHits);
+    }
+    tt_free(&tt);
+    return 0;
+}
+
+// Plays the engine against itself on a chess clock and reports how each
+// move's time compares with the limits the time manager set
+static int command_clock(int argc, char* argv[]) {
+    if (argc < 3) {
+        print_usage();
+        return 1;
+    }
+    const char* fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w - - 0 1";
+    SearchOptions options;
+    SearchLimits limits = {0};
+    search_default_options(&options);
+    static Book book;
+    for (int i = 3; i < argc; i++) {
+        bool usedNext;
+        if (parse_search_option(argv[i], i + 1 < argc ? argv[i + 1] : NULL, &options, &limits, &usedNext)) {
+            i += usedNext;
+        } else if (strcmp(argv[i], "--book") == 0 && i + 1 < argc) {
+            if (!book_open(&book, argv[++i])) {
+                printf("Error opening book %s\n", argv[i]);
+                return 1;
+            }
+        } else {
+            fen = argv[i];
+        }
+    }
+
+    Position game;
+    if (!position_set_fen(&game, fen)) {
+        printf("Invalid FEN: %s\n", fen);
+        return 1;
+    }
+
+    int increment = atoi(argv[2]);
+    int clocks[2] = {atoi(argv[1]), atoi(argv[1])};
+    static SearchContext ctx;
+    static TransTable tt;
+    if (!tt_init(&tt, TT_DEFAULT_MB)) {
+        return 1;
+    }
+
+    const char* outcome = "move limit reached";
+    for (int ply = 0; ply < 400; ply++) {
+        MoveList legal;
+        if (generate_legal_moves(&game, &legal) == 0) {
+            outcome = in_check(&game) ? "checkmate" : "stalemate";
+            break;
+        }
+        if (game.rule50 >= 100 || is_repetition(&game)) {
+            outcome = "draw";
+            break;
+        }
+
+        // Book moves are played instantly, without touching the clock
+        Move bookMove;
+        if (book_pick(&book, &game, &bookMove)) {
+            char san[16];
+            move_to_san(&game, bookMove, san);
+            printf("%3d. %-8s book\n", ply / 2 + 1, san);
+            clocks[game.side] += increment;
+            make_move(&game, bookMove);
+            continue;
+        }
+
+        int side = game.side;
+        limits.time = clocks[side];
+        limits.increment = increment;
+        SearchResult result;
+        search_init(&ctx, &game);
+        ctx.options = options;
+        ctx.tt = &tt;
+        search_position(&ctx, &limits, &result);
+        int used = search_elapsed_ms(&ctx);
+
+        char san[16];
+        move_to_san(&game, result.bestMove, san);
+        clocks[side] -= used;
+        printf("%3d. %-8s depth %2d used %5d ms soft %5d hard %5d clock %6d ms\n", ply / 2 + 1, san,
+               result.depth, used, ctx.softLimit, ctx.hardLimit, clocks[side]);
+        if (clocks[side] < 0) {
+            outcome = "lost on time";
+            break;
+        }
+        clocks[side] += increment;
+        make_move(&game, result.bestMove);
+    }
+
+    printf("Game over: %s\n", outcome);
+    book_close(&book);
+    tt_free(&tt);
+    return 0;
+}
+
+// Fixed workload for "chess bench": the perft positions, middlegames from
+// engine test suites and endgames. Changing the list changes the signature.
+static const char* benchPositions[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w - - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w - - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w - - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w - - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r3k2r/2pb1ppp/2pp1q2/p7/1nP1B3/1P2P3/P2N1PPP/R2QK2R w - - 0 14",
+    "4rrk1/2p1b1p1/p1p3q1/4p3/2P2n1p/1P1NR2P/PB3PP1/3R1QK1 b - - 2 24",
+    "r3qbrk/6p1/2b2pPp/p3pP1Q/PpPpP2P/3P1B2/2PB3K/R5R1 w - - 16 42",
+    "6k1/1R3p2/6p1/2Bp3p/3P2q1/P7/1P2rQ1K/5R2 b - - 4 44",
+    "8/8/1p2k1p1/3p3p/1p1P1P1P/1P2PK2/8/8 w - - 3 54",
+    "7r/2p3k1/1p1p1qp1/1P1Bp3/p1P2r1P/P7/4R3/Q4RK1 w - - 0 36",
+    "r1bq1rk1/pp2b1pp/n1pp1n2/3P1p2/2P1p3/2N1P2N/PP2BPPP/R2QKB1R b - - 0 10",
+    "3r2k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQP2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w - - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b - - 0 11",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+    "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+    "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+    "3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+    "2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1",
+    "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+    "7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+    "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+    "8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+    "8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+    "8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+    "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+    "6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+    "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+    "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+    "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+    "5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 93 90",
+    "4rrk1/1p1nq3/p7/2p1P1pp/3P2bp/3Q1Bn1/PPPB4/1K2R1NR w - - 40 21",
+    "r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w - - 0 16",
+    "3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+    "4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1",
+    "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+    "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+    "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+    "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+    "8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+    "8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+    "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+    "6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+};
+
+// Runs perft and a fixed-depth search on every bench position in one thread.
+// The node total depends only on move generation and search behaviour, so it
+// is a signature that changes with any functional change; the speed tracks
+// performance from commit to commit.
+static int command_bench(int argc, char* argv[]) {
+    int searchDepth = argc > 1 ? atoi(argv[1]) : 8;
+    int perftDepth = argc > 2 ? atoi(argv[2]) : 3;
+    if (searchDepth <= 0 || perftDepth <= 0) {
+        print_usage();
+        return 1;
+    }
+
+    static SearchContext ctx;
+    static TransTable tt;
+    if (!tt.entries && !tt_init(&tt, TT_DEFAULT_MB)) {
+        return 1;
+    }
+    SearchLimits limits = {0};
+    limits.depth = searchDepth;
+
+    int count = sizeof(benchPositions) / sizeof(benchPositions[0]);
+    uint64_t perftNodes = 0, searchNodes = 0;
+    uint64_t start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < count; i++) {
+        Position pos;
+        if (!position_set_fen(&pos, benchPositions[i])) {
+            printf("Invalid bench position %d: %s\n", i + 1, benchPositions[i]);
+            return 1;
+        }
+
+        uint64_t leaves = perft(&pos, perftDepth);
+
+        // A cleared table keeps each search independent of the one before
+        SearchResult result;
+        search_init(&ctx, &pos);
+        tt_clear(&tt);
+        ctx.tt = &tt;
+        search_position(&ctx, &limits, &result);
+
+        char uci[8];
+        move_to_uci(result.bestMove, uci);
+        printf("Position %2d/%d: perft %9llu search %9llu best %s\n", i + 1, count,
+               (unsigned long long)leaves, (unsigned long long)ctx.stats.nodes, uci);
+        perftNodes += leaves;
+        searchNodes += ctx.stats.nodes;
+    }
+    uint64_t ticks = SDL_GetPerformanceCounter() - start;
+    uint64_t elapsed = ticks * 1000 / SDL_GetPerformanceFrequency();
+    uint64_t nodes = perftNodes + searchNodes;
+
+    printf("\n===========================\n");
+    printf("Perft nodes  : %llu (depth %d)\n", (unsigned long long)perftNodes, perftDepth);
+    printf("Search nodes : %llu (depth %d)\n", (unsigned long long)searchNodes, searchDepth);
+    printf("Total time   : %llu ms\n", (unsigned long long)elapsed);
+    printf("Nodes        : %llu\n", (unsigned long long)nodes);
+    printf("Nodes/second : %llu\n", (unsigned long long)(elapsed ? nodes * 1000 / elapsed : 0));
+    return 0;
+}
+
+// Proves the shortest forced mate with the proof-number solver
+static int command_mate(int argc, char* argv[]) {
+    if (argc < 2) {
+        print_usage();
+        return 1;
+    }
+    Position pos;
+    if (!position_set_fen(&pos, argv[1])) {
+        printf("Invalid FEN: %s\n", argv[1]);
+        return 1;
+    }
+    int maxMoves = argc > 2 ? atoi(argv[2]) : MATE_MAX_MOVES;
+    uint64_t nodeLimit = argc > 3 ? strtoull(argv[3], NULL, 10) : MATE_DEFAULT_NODES;
+
+    MateResult result;
+    mate_search(&pos, maxMoves, nodeLimit, NULL, &result);
+
+    char text[256];
+    mate_format_line(&pos, &result, text, sizeof(text));
+    printf("%s\n", text);
+    printf("Nodes %llu, time %d ms\n", (unsigned long long)result.nodes, result.elapsed);
+    return result.found ? 0 : 2;
+}
+
+// Generates an endgame table and the smaller ones it needs
+static int command_tbgen(int argc, char* argv[]) {
+    if (argc < 2) {
+        print_usage();
+        return 1;
+    }
+    const char* dir = ".";
+    int threads = SDL_GetCPUCount();
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    return tb_generate(argv[1], dir, threads) ? 0 : 1;
+}
+
+// Looks a position and each of its moves up in the endgame tables, and
+// times the probe itself
+static int command_tbprobe(int argc, char* argv[]) {
+    if (argc < 2) {
+        print_usage();
+        return 1;
+    }
+    Position pos;
+    if (!position_set_fen(&pos, argv[1])) {
+        printf("Invalid FEN: %s\n", argv[1]);
+        return 1;
+    }
+    const char* dir = argc > 2 ? argv[2] : TB_DEFAULT_DIR;
+    int count = tb_init(dir);
+    printf("Mapped %d endgame tables from %s, up to %d pieces\n", count, dir, tb_max_pieces());
+
+    TablebaseResult result;
+    char text[64];
+    if (!tb_probe(&pos, &result)) {
+        printf("No table covers this position\n");
+        tb_free();
+        return 2;
+    }
+    tb_format_result(&pos, &result, text, sizeof(text));
+    printf("%s\n", text);
+
+    MoveList list;
+    generate_legal_moves(&pos, &list);
+    for (int i = 0; i < list.count; i++) {
+        char san[16];
+        move_to_san(&pos, list.moves[i], san);
+        make_move(&pos, list.moves[i]);
+        if (tb_probe(&pos, &result)) {
+            tb_format_result(&pos, &result, text, sizeof(text));
+            printf("  %-8s %s\n", san, text);
+        } else {
+            printf("  %-8s not in the tables\n", san);
+        }
+        unmake_move(&pos, list.moves[i]);
+    }
+
+    // The first probes fault the pages in; the timed ones show a warm lookup
+    const int probes = 1000000;
+    uint64_t start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < probes; i++) {
+        tb_probe(&pos, &result);
+    }
+    uint64_t ticks = SDL_GetPerformanceCounter() - start;
+    printf("Probe time %.0f ns\n", (double)ticks * 1e9 / SDL_GetPerformanceFrequency() / probes);
+    tb_free();
+    return 0;
+}
+
+// Lists the book moves for a position and times the lookup
+static int command_book(int argc, char* argv[]) {
+    if (argc < 2) {
+        print_usage();
+        return 1;
+    }
+    const char* fen = argc > 2 ? argv[2] : "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w - - 0 1";
+    Position pos;
+    if (!position_set_fen(&pos, fen)) {
+        printf("Invalid FEN: %s\n", fen);
+        return 1;
+    }
+    static Book book;
+    if (!book_open(&book, argv[1])) {
+        printf("Error opening book %s\n", argv[1]);
+        return 1;
+    }
+    printf("%s: %llu entries, key %016llx\n", argv[1], (unsigned long long)book.count,
+           (unsigned long long)book_key(&pos));
+
+    BookMove moves[MAX_BOOK_MOVES];
+    int count = book_probe(&book, &pos, moves, MAX_BOOK_MOVES);
+    for (int i = 0; i < count; i++) {
+        char san[16];
+        move_to_san(&pos, moves[i].move, san);
+        printf("  %-8s weight %d\n", san, moves[i].weight);
+    }
+    if (count == 0) {
+        printf("Not in the book\n");
+    }
+
+    const int lookups = 100000;
+    uint64_t start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < lookups; i++) {
+        book_probe(&book, &pos, moves, MAX_BOOK_MOVES);
+    }
+    uint64_t ticks = SDL_GetPerformanceCounter() - start;
+    printf("Lookup time %.0f ns\n", (double)ticks * 1e9 / SDL_GetPerformanceFrequency() / lookups);
+    book_close(&book);
+    return count > 0 ? 0 : 2;
+}
+
+// Builds an opening book from a PGN collection
+static int command_bookgen(int argc, char* argv[]) {
+    if (argc < 3) {
+        print_usage();
+        return 1;
+    }
+    BookBuildOptions options = {24, SDL_GetCPUCount(), 512, 1};
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--plies") == 0 && i + 1 < argc) {
+            options.maxPlies = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--memory") == 0 && i + 1 < argc) {
+            options.memoryMB = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min-games") == 0 && i + 1 < argc) {
+            options.minGames = atoi(argv[++i]);
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (options.maxPlies < 1 || options.maxPlies > MAX_GAME_PLY - 1) {
+        options.maxPlies = MAX_GAME_PLY - 1;
+    }
+    return book_build(argv[1], argv[2], &options) ? 0 : 1;
+}
+
+int run_command(int argc, char* argv[]) {
+    if (strcmp(argv[0], "epd") == 0) {
+        return command_epd(argc, argv);
+    }
+    if (strcmp(argv[0], "eval") == 0) {
+        return command_eval(argc, argv);
+    }
+    if (strcmp(argv[0], "nnue") == 0) {
+        return command_nnue(argc, argv);
+    }
+    if (strcmp(argv[0], "analyze") == 0) {
+        return command_analyze(argc, argv);
+    }
+    if (strcmp(argv[0], "clock") == 0) {
+        return command_clock(argc, argv);
+    }
+    if (strcmp(argv[0], "bench") == 0) {
+        return command_bench(argc, argv);
+    }
+    if (strcmp(argv[0], "mate") == 0) {
+        return command_mate(argc, argv);
+    }
+    if (strcmp(argv[0], "tbgen") == 0) {
+        return command_tbgen(argc, argv);
+    }
+    if (strcmp(argv[0], "tbprobe") == 0) {
+        return command_tbprobe(argc, argv);
+    }
+    if (strcmp(argv[0], "book") == 0) {
+        return command_book(argc, argv);
+    }
+    if (strcmp(argv[0], "bookgen") == 0) {
+        return command_bookgen(argc, argv);
+    }
+    print_usage();
+    return 1;
+}
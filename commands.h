@@ -0,0 +1,8 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+// Headless engine commands, run as "chess <command> [arguments]" without
+// opening a window. Returns the process exit code.
+int run_command(int argc, char* argv[]);
+
+#endif
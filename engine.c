@@ -0,0 +1,803 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "engine.h"
+#include "evaluate.h"
+
+const Move NO_MOVE = {0, 0, ' ', ' ', ' '};
+
+static const char pieceChars[] = "pnbrqkPNBRQK";
+
+static const int knightOffsets[8][2] = {
+    {-2, -1}, {-2, 1}, {-1, -2}, {-1, 2}, {1, -2}, {1, 2}, {2, -1}, {2, 1}
+};
+static const int kingOffsets[8][2] = {
+    {-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}
+};
+static const int bishopDirections[4][2] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+static const int rookDirections[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+// Zobrist keys, indexed by piece index (see piece_index) and square
+static uint64_t pieceKeys[12][64];
+static uint64_t sideKey;
+static signed char pieceIndexes[256];
+static bool engineInitialized = false;
+
+int piece_index(char piece) {
+    return pieceIndexes[(unsigned char)piece];
+}
+
+static uint64_t next_random(uint64_t* state) {
+    // xorshift64*, fixed seed so keys are identical on every run
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+void engine_init(void) {
+    if (engineInitialized) {
+        return;
+    }
+    memset(pieceIndexes, -1, sizeof(pieceIndexes));
+    for (int p = 0; p < 12; p++) {
+        pieceIndexes[(unsigned char)pieceChars[p]] = p;
+    }
+
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (int p = 0; p < 12; p++) {
+        for (int sq = 0; sq < 64; sq++) {
+            pieceKeys[p][sq] = next_random(&state);
+        }
+    }
+    sideKey = next_random(&state);
+    eval_init();
+    engineInitialized = true;
+}
+
+int piece_side(char piece) {
+    return islower((unsigned char)piece) ? SIDE_WHITE : SIDE_BLACK;
+}
+
+int piece_value(char piece) {
+    switch (tolower((unsigned char)piece)) {
+        case 'p': return PAWN_VALUE;
+        case 'n': return KNIGHT_VALUE;
+        case 'b': return BISHOP_VALUE;
+        case 'r': return ROOK_VALUE;
+        case 'q': return QUEEN_VALUE;
+        default: return 0;
+    }
+}
+
+bool move_equals(Move a, Move b) {
+    return a.from == b.from && a.to == b.to && a.promotion == b.promotion;
+}
+
+bool move_is_none(Move move) {
+    return move.piece == ' ';
+}
+
+static void position_refresh(Position* pos) {
+    pos->material[SIDE_WHITE] = 0;
+    pos->material[SIDE_BLACK] = 0;
+    pos->pawnBits[SIDE_WHITE] = 0;
+    pos->pawnBits[SIDE_BLACK] = 0;
+    pos->kingSquare[SIDE_WHITE] = -1;
+    pos->kingSquare[SIDE_BLACK] = -1;
+    pos->key = 0;
+    pos->pawnKey = 0;
+
+    for (int sq = 0; sq < 64; sq++) {
+        char piece = pos->board[SQUARE_ROW(sq)][SQUARE_COL(sq)];
+        if (piece == ' ') {
+            continue;
+        }
+        int side = piece_side(piece);
+        if (tolower((unsigned char)piece) == 'k') {
+            pos->kingSquare[side] = sq;
+        }
+        pos->material[side] += piece_value(piece);
+        pos->key ^= pieceKeys[piece_index(piece)][sq];
+        if (tolower((unsigned char)piece) == 'p') {
+            pos->pawnBits[side] |= 1ULL << sq;
+            pos->pawnKey ^= pieceKeys[piece_index(piece)][sq];
+        }
+    }
+    if (pos->side == SIDE_BLACK) {
+        pos->key ^= sideKey;
+    }
+    eval_refresh(pos);
+    pos->historyLength = 0;
+}
+
+void position_set_board(Position* pos, char board[8][8], char turn) {
+    engine_init();
+    memcpy(pos->board, board, sizeof(pos->board));
+    pos->side = (turn == 'B') ? SIDE_WHITE : SIDE_BLACK;
+    pos->rule50 = 0;
+    position_refresh(pos);
+}
+
+bool position_set_fen(Position* pos, const char* fen) {
+    engine_init();
+    memset(pos->board, ' ', sizeof(pos->board));
+
+    int row = 0;
+    int col = 0;
+    const char* c = fen;
+    while (*c == ' ') {
+        c++;
+    }
+    for (; *c && *c != ' '; c++) {
+        if (*c == '/') {
+            row++;
+            col = 0;
+        } else if (isdigit((unsigned char)*c)) {
+            col += *c - '0';
+        } else {
+            if (row > 7 || col > 7 || piece_index(*c) < 0) {
+                return false;
+            }
+            // No pawn stands on the first or last rank in a real game, and
+            // the evaluation's tables assume none does
+            if ((*c == 'p' || *c == 'P') && (row == 0 || row == 7)) {
+                return false;
+            }
+            // FEN white pieces are the lowercase pieces on this board
+            char piece = *c;
+            pos->board[row][col++] = isupper((unsigned char)piece) ? tolower((unsigned char)piece) : toupper((unsigned char)piece);
+        }
+    }
+    if (row != 7) {
+        return false;
+    }
+
+    while (*c == ' ') {
+        c++;
+    }
+    pos->side = (*c == 'b') ? SIDE_BLACK : SIDE_WHITE;
+    pos->rule50 = 0;
+
+    // Castling and en passant fields are skipped, the game has neither. Pick up
+    // the halfmove clock when a full FEN is given.
+    int field = 0;
+    while (*c && field < 3) {
+        if (*c == ' ' && c[1] != ' ') {
+            field++;
+        }
+        c++;
+    }
+    if (field == 3 && isdigit((unsigned char)*c)) {
+        pos->rule50 = atoi(c);
+    }
+
+    position_refresh(pos);
+    return pos->kingSquare[SIDE_WHITE] >= 0 && pos->kingSquare[SIDE_BLACK] >= 0;
+}
+
+void position_to_fen(const Position* pos, char* fen, int size) {
+    char buffer[128];
+    int n = 0;
+    for (int row = 0; row < 8; row++) {
+        int empty = 0;
+        for (int col = 0; col < 8; col++) {
+            char piece = pos->board[row][col];
+            if (piece == ' ') {
+                empty++;
+                continue;
+            }
+            if (empty) {
+                buffer[n++] = '0' + empty;
+                empty = 0;
+            }
+            buffer[n++] = isupper((unsigned char)piece) ? tolower((unsigned char)piece) : toupper((unsigned char)piece);
+        }
+        if (empty) {
+            buffer[n++] = '0' + empty;
+        }
+        if (row < 7) {
+            buffer[n++] = '/';
+        }
+    }
+    buffer[n] = '\0';
+    snprintf(fen, size, "%s %c - - %d 1", buffer, pos->side == SIDE_WHITE ? 'w' : 'b', pos->rule50);
+}
+
+char position_turn(const Position* pos) {
+    return pos->side == SIDE_WHITE ? 'B' : 'W';
+}
+
+static bool on_board(int row, int col) {
+    return row >= 0 && row < 8 && col >= 0 && col < 8;
+}
+
+static void add_move(const Position* pos, MoveList* list, int from, int to, char promotion) {
+    Move* move = &list->moves[list->count++];
+    move->from = from;
+    move->to = to;
+    move->piece = pos->board[SQUARE_ROW(from)][SQUARE_COL(from)];
+    move->captured = pos->board[SQUARE_ROW(to)][SQUARE_COL(to)];
+    move->promotion = promotion;
+}
+
+static void add_pawn_move(const Position* pos, MoveList* list, int from, int to, int side) {
+    int promotionRow = (side == SIDE_WHITE) ? 0 : 7;
+    if (SQUARE_ROW(to) == promotionRow) {
+        add_move(pos, list, from, to, side == SIDE_WHITE ? 'q' : 'Q');
+        add_move(pos, list, from, to, side == SIDE_WHITE ? 'n' : 'N');
+    } else {
+        add_move(pos, list, from, to, ' ');
+    }
+}
+
+static bool is_enemy(char piece, int side) {
+    return piece != ' ' && piece_side(piece) != side;
+}
+
+int generate_moves(const Position* pos, MoveList* list, bool capturesOnly) {
+    int side = pos->side;
+    list->count = 0;
+
+    for (int from = 0; from < 64; from++) {
+        int row = SQUARE_ROW(from);
+        int col = SQUARE_COL(from);
+        char piece = pos->board[row][col];
+        if (piece == ' ' || piece_side(piece) != side) {
+            continue;
+        }
+
+        switch (tolower((unsigned char)piece)) {
+            case 'p': {
+                int direction = (side == SIDE_WHITE) ? -1 : 1;
+                int startRow = (side == SIDE_WHITE) ? 6 : 1;
+                int promotionRow = (side == SIDE_WHITE) ? 0 : 7;
+                int ahead = row + direction;
+                if (!on_board(ahead, col)) {
+                    break;
+                }
+                // Quiet pushes, plus push-promotions which the quiescence search wants too
+                if (pos->board[ahead][col] == ' ' && (!capturesOnly || ahead == promotionRow)) {
+                    add_pawn_move(pos, list, from, SQUARE(ahead, col), side);
+                    if (!capturesOnly && row == startRow && pos->board[ahead + direction][col] == ' ') {
+                        add_move(pos, list, from, SQUARE(ahead + direction, col), ' ');
+                    }
+                }
+                for (int dc = -1; dc <= 1; dc += 2) {
+                    if (on_board(ahead, col + dc) && is_enemy(pos->board[ahead][col + dc], side)) {
+                        add_pawn_move(pos, list, from, SQUARE(ahead, col + dc), side);
+                    }
+                }
+                break;
+            }
+            case 'n':
+            case 'k': {
+                const int (*offsets)[2] = (tolower((unsigned char)piece) == 'n') ? knightOffsets : kingOffsets;
+                for (int i = 0; i < 8; i++) {
+                    int r = row + offsets[i][0];
+                    int c = col + offsets[i][1];
+                    if (!on_board(r, c)) {
+                        continue;
+                    }
+                    char target = pos->board[r][c];
+                    if (target == ' ' ? !capturesOnly : is_enemy(target, side)) {
+                        add_move(pos, list, from, SQUARE(r, c), ' ');
+                    }
+                }
+                break;
+            }
+            default: {
+                char type = tolower((unsigned char)piece);
+                for (int set = 0; set < 2; set++) {
+                    const int (*directions)[2] = set == 0 ? bishopDirections : rookDirections;
+                    if ((set == 0 && type == 'r') || (set == 1 && type == 'b')) {
+                        continue;
+                    }
+                    for (int d = 0; d < 4; d++) {
+                        int r = row + directions[d][0];
+                        int c = col + directions[d][1];
+                        while (on_board(r, c)) {
+                            char target = pos->board[r][c];
+                            if (target == ' ') {
+                                if (!capturesOnly) {
+                                    add_move(pos, list, from, SQUARE(r, c), ' ');
+                                }
+                            } else {
+                                if (is_enemy(target, side)) {
+                                    add_move(pos, list, from, SQUARE(r, c), ' ');
+                                }
+                                break;
+                            }
+                            r += directions[d][0];
+                            c += directions[d][1];
+                        }
+                    }
+                }
+                break;
+            }
+        }
+    }
+    return list->count;
+}
+
+// Counts the leaf nodes of the legal move tree to the given depth
+uint64_t perft(Position* pos, int depth) {
+    MoveList list;
+    generate_moves(pos, &list, false);
+    uint64_t nodes = 0;
+    for (int i = 0; i < list.count; i++) {
+        if (!make_move(pos, list.moves[i])) {
+            continue;
+        }
+        nodes += depth > 1 ? perft(pos, depth - 1) : 1;
+        unmake_move(pos, list.moves[i]);
+    }
+    return nodes;
+}
+
+int generate_legal_moves(Position* pos, MoveList* list) {
+    MoveList pseudo;
+    generate_moves(pos, &pseudo, false);
+    list->count = 0;
+    for (int i = 0; i < pseudo.count; i++) {
+        if (make_move(pos, pseudo.moves[i])) {
+            unmake_move(pos, pseudo.moves[i]);
+            list->moves[list->count++] = pseudo.moves[i];
+        }
+    }
+    return list->count;
+}
+
+bool square_attacked(const Position* pos, int sq, int bySide) {
+    int row = SQUARE_ROW(sq);
+    int col = SQUARE_COL(sq);
+    bool lower = (bySide == SIDE_WHITE);
+
+    // A pawn attacks diagonally forward, so look one row behind the square
+    int pawnRow = row + (bySide == SIDE_WHITE ? 1 : -1);
+    char pawn = lower ? 'p' : 'P';
+    if (on_board(pawnRow, col - 1) && pos->board[pawnRow][col - 1] == pawn) return true;
+    if (on_board(pawnRow, col + 1) && pos->board[pawnRow][col + 1] == pawn) return true;
+
+    char knight = lower ? 'n' : 'N';
+    char king = lower ? 'k' : 'K';
+    for (int i = 0; i < 8; i++) {
+        int r = row + knightOffsets[i][0];
+        int c = col + knightOffsets[i][1];
+        if (on_board(r, c) && pos->board[r][c] == knight) return true;
+        r = row + kingOffsets[i][0];
+        c = col + kingOffsets[i][1];
+        if (on_board(r, c) && pos->board[r][c] == king) return true;
+    }
+
+    char queen = lower ? 'q' : 'Q';
+    char bishop = lower ? 'b' : 'B';
+    char rook = lower ? 'r' : 'R';
+    for (int d = 0; d < 4; d++) {
+        int r = row + bishopDirections[d][0];
+        int c = col + bishopDirections[d][1];
+        while (on_board(r, c)) {
+            char piece = pos->board[r][c];
+            if (piece != ' ') {
+                if (piece == bishop || piece == queen) return true;
+                break;
+            }
+            r += bishopDirections[d][0];
+            c += bishopDirections[d][1];
+        }
+        r = row + rookDirections[d][0];
+        c = col + rookDirections[d][1];
+        while (on_board(r, c)) {
+            char piece = pos->board[r][c];
+            if (piece != ' ') {
+                if (piece == rook || piece == queen) return true;
+                break;
+            }
+            r += rookDirections[d][0];
+            c += rookDirections[d][1];
+        }
+    }
+    return false;
+}
+
+bool in_check(const Position* pos) {
+    return square_attacked(pos, pos->kingSquare[pos->side], pos->side ^ 1);
+}
+
+bool make_move(Position* pos, Move move) {
+    int side = pos->side;
+    Undo* undo = &pos->history[pos->historyLength++];
+    undo->key = pos->key;
+    undo->pawnKey = pos->pawnKey;
+    undo->rule50 = pos->rule50;
+    undo->mg = pos->mg;
+    undo->eg = pos->eg;
+    undo->phase = pos->phase;
+
+    char placed = (move.promotion != ' ') ? move.promotion : move.piece;
+    int movedIndex = piece_index(move.piece);
+    int placedIndex = piece_index(placed);
+    pos->board[SQUARE_ROW(move.from)][SQUARE_COL(move.from)] = ' ';
+    pos->board[SQUARE_ROW(move.to)][SQUARE_COL(move.to)] = placed;
+
+    pos->key ^= pieceKeys[movedIndex][move.from];
+    pos->key ^= pieceKeys[placedIndex][move.to];
+    pos->key ^= sideKey;
+
+    // Keep the evaluation sums in step with the board
+    pos->mg += psqtMg[placedIndex][move.to] - psqtMg[movedIndex][move.from];
+    pos->eg += psqtEg[placedIndex][move.to] - psqtEg[movedIndex][move.from];
+    pos->phase += phaseWeight[placedIndex] - phaseWeight[movedIndex];
+
+    if (move.captured != ' ') {
+        int capturedIndex = piece_index(move.captured);
+        pos->key ^= pieceKeys[capturedIndex][move.to];
+        pos->mg -= psqtMg[capturedIndex][move.to];
+        pos->eg -= psqtEg[capturedIndex][move.to];
+        pos->phase -= phaseWeight[capturedIndex];
+        pos->material[side ^ 1] -= piece_value(move.captured);
+        if (tolower((unsigned char)move.captured) == 'p') {
+            pos->pawnBits[side ^ 1] ^= 1ULL << move.to;
+            pos->pawnKey ^= pieceKeys[capturedIndex][move.to];
+        }
+    }
+    if (move.promotion != ' ') {
+        pos->material[side] += piece_value(move.promotion) - PAWN_VALUE;
+    }
+    if (tolower((unsigned char)move.piece) == 'p') {
+        pos->pawnBits[side] ^= 1ULL << move.from;
+        pos->pawnKey ^= pieceKeys[movedIndex][move.from];
+        if (move.promotion == ' ') {
+            pos->pawnBits[side] ^= 1ULL << move.to;
+            pos->pawnKey ^= pieceKeys[movedIndex][move.to];
+        }
+    }
+    if (tolower((unsigned char)move.piece) == 'k') {
+        pos->kingSquare[side] = move.to;
+    }
+    pos->rule50 = (move.captured != ' ' || tolower((unsigned char)move.piece) == 'p') ? 0 : pos->rule50 + 1;
+    pos->side = side ^ 1;
+
+    // Pseudo-legal moves that leave the mover's king attacked are taken back
+    if (square_attacked(pos, pos->kingSquare[side], side ^ 1)) {
+        unmake_move(pos, move);
+        return false;
+    }
+    return true;
+}
+
+void unmake_move(Position* pos, Move move) {
+    pos->side ^= 1;
+    int side = pos->side;
+
+    pos->board[SQUARE_ROW(move.from)][SQUARE_COL(move.from)] = move.piece;
+    pos->board[SQUARE_ROW(move.to)][SQUARE_COL(move.to)] = move.captured;
+
+    if (move.captured != ' ') {
+        pos->material[side ^ 1] += piece_value(move.captured);
+        if (tolower((unsigned char)move.captured) == 'p') {
+            pos->pawnBits[side ^ 1] ^= 1ULL << move.to;
+        }
+    }
+    if (move.promotion != ' ') {
+        pos->material[side] -= piece_value(move.promotion) - PAWN_VALUE;
+    }
+    if (tolower((unsigned char)move.piece) == 'p') {
+        pos->pawnBits[side] ^= 1ULL << move.from;
+        if (move.promotion == ' ') {
+            pos->pawnBits[side] ^= 1ULL << move.to;
+        }
+    }
+    if (tolower((unsigned char)move.piece) == 'k') {
+        pos->kingSquare[side] = move.from;
+    }
+
+    Undo* undo = &pos->history[--pos->historyLength];
+    pos->key = undo->key;
+    pos->pawnKey = undo->pawnKey;
+    pos->rule50 = undo->rule50;
+    pos->mg = undo->mg;
+    pos->eg = undo->eg;
+    pos->phase = undo->phase;
+}
+
+// Passes the move to the opponent. The halfmove clock restarts so repetition
+// checks never look across a null move.
+void make_null_move(Position* pos) {
+    Undo* undo = &pos->history[pos->historyLength++];
+    undo->key = pos->key;
+    undo->rule50 = pos->rule50;
+    pos->key ^= sideKey;
+    pos->rule50 = 0;
+    pos->side ^= 1;
+}
+
+void unmake_null_move(Position* pos) {
+    Undo* undo = &pos->history[--pos->historyLength];
+    pos->key = undo->key;
+    pos->rule50 = undo->rule50;
+    pos->side ^= 1;
+}
+
+bool has_non_pawn_material(const Position* pos, int side) {
+    return pos->material[side] > __builtin_popcountll(pos->pawnBits[side]) * PAWN_VALUE;
+}
+
+bool is_repetition(const Position* pos) {
+    // Only positions since the last irreversible move can repeat, and only
+    // those with the same side to move
+    int first = pos->historyLength - pos->rule50;
+    for (int i = pos->historyLength - 2; i >= 0 && i >= first; i -= 2) {
+        if (pos->history[i].key == pos->key) {
+            return true;
+        }
+    }
+    return pos->rule50 >= 100;
+}
+
+// Finds the least valuable piece of the given side attacking sq on board
+static int least_valuable_attacker(char board[8][8], int sq, int side) {
+    int row = SQUARE_ROW(sq);
+    int col = SQUARE_COL(sq);
+    bool lower = (side == SIDE_WHITE);
+    int best = -1;
+    int bestValue = 1000000;
+
+    int pawnRow = row + (side == SIDE_WHITE ? 1 : -1);
+    char pawn = lower ? 'p' : 'P';
+    for (int dc = -1; dc <= 1; dc += 2) {
+        if (on_board(pawnRow, col + dc) && board[pawnRow][col + dc] == pawn) {
+            return SQUARE(pawnRow, col + dc);
+        }
+    }
+
+    char knight = lower ? 'n' : 'N';
+    for (int i = 0; i < 8; i++) {
+        int r = row + knightOffsets[i][0];
+        int c = col + knightOffsets[i][1];
+        if (on_board(r, c) && board[r][c] == knight) {
+            return SQUARE(r, c);
+        }
+    }
+
+    for (int set = 0; set < 2; set++) {
+        const int (*directions)[2] = set == 0 ? bishopDirections : rookDirections;
+        char slider = lower ? (set == 0 ? 'b' : 'r') : (set == 0 ? 'B' : 'R');
+        char queen = lower ? 'q' : 'Q';
+        for (int d = 0; d < 4; d++) {
+            int r = row + directions[d][0];
+            int c = col + directions[d][1];
+            while (on_board(r, c)) {
+                char piece = board[r][c];
+                if (piece != ' ') {
+                    if ((piece == slider || piece == queen) && piece_value(piece) < bestValue) {
+                        best = SQUARE(r, c);
+                        bestValue = piece_value(piece);
+                    }
+                    break;
+                }
+                r += directions[d][0];
+                c += directions[d][1];
+            }
+        }
+    }
+    if (best >= 0) {
+        return best;
+    }
+
+    char king = lower ? 'k' : 'K';
+    for (int i = 0; i < 8; i++) {
+        int r = row + kingOffsets[i][0];
+        int c = col + kingOffsets[i][1];
+        if (on_board(r, c) && board[r][c] == king) {
+            return SQUARE(r, c);
+        }
+    }
+    return -1;
+}
+
+// Static exchange evaluation: the material balance of the capture sequence on
+// move.to when both sides always recapture with their least valuable piece.
+// Sliders behind the capturing piece are found again after it moves away, so
+// x-ray attackers are counted.
+int see(const Position* pos, Move move) {
+    char board[8][8];
+    memcpy(board, pos->board, sizeof(board));
+
+    int gain[32];
+    int depth = 0;
+    int sq = move.to;
+    char onSquare = (move.promotion != ' ') ? move.promotion : move.piece;
+
+    gain[0] = piece_value(move.captured);
+    if (move.promotion != ' ') {
+        gain[0] += piece_value(move.promotion) - PAWN_VALUE;
+    }
+    board[SQUARE_ROW(move.from)][SQUARE_COL(move.from)] = ' ';
+    board[SQUARE_ROW(sq)][SQUARE_COL(sq)] = onSquare;
+    int side = pos->side ^ 1;
+
+    while (depth < 31) {
+        int from = least_valuable_attacker(board, sq, side);
+        if (from < 0) {
+            break;
+        }
+        // Capturing the king is only possible if nothing defends the square
+        if (tolower((unsigned char)onSquare) == 'k') {
+            depth++;
+            gain[depth] = SCORE_MATE - gain[depth - 1];
+            break;
+        }
+        char attacker = board[SQUARE_ROW(from)][SQUARE_COL(from)];
+        depth++;
+        gain[depth] = piece_value(onSquare) - gain[depth - 1];
+        board[SQUARE_ROW(from)][SQUARE_COL(from)] = ' ';
+        board[SQUARE_ROW(sq)][SQUARE_COL(sq)] = attacker;
+        onSquare = attacker;
+        side ^= 1;
+    }
+
+    while (depth > 0) {
+        if (-gain[depth] < gain[depth - 1]) {
+            gain[depth - 1] = -gain[depth];
+        }
+        depth--;
+    }
+    return gain[0];
+}
+
+void move_to_uci(Move move, char* text) {
+    text[0] = 'a' + SQUARE_COL(move.from);
+    text[1] = '8' - SQUARE_ROW(move.from);
+    text[2] = 'a' + SQUARE_COL(move.to);
+    text[3] = '8' - SQUARE_ROW(move.to);
+    text[4] = '\0';
+    if (move.promotion != ' ') {
+        // UCI promotion letters are lowercase whichever side promotes
+        text[4] = tolower((unsigned char)move.promotion);
+        text[5] = '\0';
+    }
+}
+
+void move_to_san(Position* pos, Move move, char* text) {
+    int n = 0;
+    char type = toupper((unsigned char)move.piece);
+
+    if (type == 'P') {
+        if (move.captured != ' ') {
+            text[n++] = 'a' + SQUARE_COL(move.from);
+            text[n++] = 'x';
+        }
+        text[n++] = 'a' + SQUARE_COL(move.to);
+        text[n++] = '8' - SQUARE_ROW(move.to);
+        if (move.promotion != ' ') {
+            text[n++] = '=';
+            text[n++] = toupper((unsigned char)move.promotion);
+        }
+    } else {
+        text[n++] = type;
+
+        // Disambiguate against other pieces of the same type reaching move.to
+        MoveList legal;
+        generate_legal_moves(pos, &legal);
+        bool ambiguous = false, sameCol = false, sameRow = false;
+        for (int i = 0; i < legal.count; i++) {
+            Move other = legal.moves[i];
+            if (other.piece == move.piece && other.to == move.to && other.from != move.from) {
+                ambiguous = true;
+                sameCol |= SQUARE_COL(other.from) == SQUARE_COL(move.from);
+                sameRow |= SQUARE_ROW(other.from) == SQUARE_ROW(move.from);
+            }
+        }
+        if (ambiguous) {
+            if (!sameCol) {
+                text[n++] = 'a' + SQUARE_COL(move.from);
+            } else if (!sameRow) {
+                text[n++] = '8' - SQUARE_ROW(move.from);
+            } else {
+                text[n++] = 'a' + SQUARE_COL(move.from);
+                text[n++] = '8' - SQUARE_ROW(move.from);
+            }
+        }
+        if (move.captured != ' ') {
+            text[n++] = 'x';
+        }
+        text[n++] = 'a' + SQUARE_COL(move.to);
+        text[n++] = '8' - SQUARE_ROW(move.to);
+    }
+
+    if (make_move(pos, move)) {
+        if (in_check(pos)) {
+            MoveList replies;
+            text[n++] = generate_legal_moves(pos, &replies) == 0 ? '#' : '+';
+        }
+        unmake_move(pos, move);
+    }
+    text[n] = '\0';
+}
+
+// Reads the piece, target square, disambiguation and promotion out of the
+// text and matches them against the legal moves, instead of writing every
+// legal move out in SAN. Fails unless exactly one move fits.
+Move parse_san(Position* pos, const char* text) {
+    char san[16];
+    int n = 0;
+    // Compare without check, mate and annotation marks
+    for (const char* c = text; *c && n < 15; c++) {
+        if (!strchr("+#!?=", *c)) {
+            san[n++] = *c;
+        }
+    }
+    san[n] = '\0';
+
+    char type = 'P';
+    int start = 0;
+    if (n > 0 && strchr("KQRBN", san[0])) {
+        type = san[0];
+        start = 1;
+    }
+    // Promotions with or without '=' (e8=Q, e8Q)
+    char promotion = ' ';
+    if (type == 'P' && n > 0 && strchr("QRBN", san[n - 1])) {
+        promotion = san[--n];
+    }
+    if (n - start < 2) {
+        return NO_MOVE;
+    }
+    char file = san[n - 2];
+    char rank = san[n - 1];
+    if (file < 'a' || file > 'h' || rank < '1' || rank > '8') {
+        return NO_MOVE;
+    }
+    int to = SQUARE('8' - rank, file - 'a');
+
+    int fromCol = -1, fromRow = -1;
+    for (int i = start; i < n - 2; i++) {
+        if (san[i] >= 'a' && san[i] <= 'h') {
+            fromCol = san[i] - 'a';
+        } else if (san[i] >= '1' && san[i] <= '8') {
+            fromRow = '8' - san[i];
+        } else if (san[i] != 'x') {
+            return NO_MOVE;
+        }
+    }
+    // A pawn only names its file when it captures
+    if (type == 'P' && fromCol < 0) {
+        fromCol = file - 'a';
+    }
+
+    // Only the moves that fit the text are tried for legality, usually one
+    MoveList pseudo;
+    generate_moves(pos, &pseudo, false);
+    Move found = NO_MOVE;
+    int matches = 0;
+    for (int i = 0; i < pseudo.count; i++) {
+        Move move = pseudo.moves[i];
+        if (toupper((unsigned char)move.piece) != type || move.to != to
+            || (fromCol >= 0 && SQUARE_COL(move.from) != fromCol)
+            || (fromRow >= 0 && SQUARE_ROW(move.from) != fromRow)
+            || toupper((unsigned char)move.promotion) != promotion) {
+            continue;
+        }
+        if (make_move(pos, move)) {
+            unmake_move(pos, move);
+            found = move;
+            matches++;
+        }
+    }
+    return matches == 1 ? found : NO_MOVE;
+}
+
+Move parse_uci(Position* pos, const char* text) {
+    MoveList legal;
+    generate_legal_moves(pos, &legal);
+    for (int i = 0; i < legal.count; i++) {
+        char uci[8];
+        move_to_uci(legal.moves[i], uci);
+        if (strcmp(uci, text) == 0) {
+            return legal.moves[i];
+        }
+    }
+    return NO_MOVE;
+}
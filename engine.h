@@ -0,0 +1,113 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The engine works on the same char[8][8] board as the game. Row 0 is the top
+// of the screen. Lowercase pieces start on rows 6-7, are drawn with the white
+// piece images and move when turn == BLACK ('B'); uppercase pieces start on
+// rows 0-1 and move when turn == WHITE ('W'). Inside the engine the sides are
+// named after the chess colours, so SIDE_WHITE is the lowercase side and FEN
+// strings map onto the board with the letter case swapped.
+//
+// The rules are the ones functions.c enforces: no castling, no en passant and
+// pawns promote to a queen or a knight only (the promotion menu choices).
+
+#define SIDE_WHITE 0 // lowercase pieces, UI turn BLACK
+#define SIDE_BLACK 1 // uppercase pieces, UI turn WHITE
+
+#define MAX_MOVES 256
+#define MAX_PLY 64
+#define MAX_GAME_PLY 1024
+
+#define SCORE_INFINITE 32000
+#define SCORE_MATE 30000
+#define SCORE_MATE_IN_MAX (SCORE_MATE - MAX_PLY)
+// Endgame-table mates, up to 252 plies past the search horizon, score
+// between here and SCORE_MATE_IN_MAX
+#define SCORE_TB_MATE_IN_MAX (SCORE_MATE_IN_MAX - 256)
+
+#define PAWN_VALUE 100
+#define KNIGHT_VALUE 320
+#define BISHOP_VALUE 330
+#define ROOK_VALUE 500
+#define QUEEN_VALUE 900
+
+#define SQUARE(row, col) ((row) * 8 + (col))
+#define SQUARE_ROW(sq) ((sq) >> 3)
+#define SQUARE_COL(sq) ((sq) & 7)
+
+typedef struct {
+    unsigned char from;   // SQUARE(row, col)
+    unsigned char to;
+    char piece;           // the piece being moved
+    char captured;        // ' ' when the target square is empty
+    char promotion;       // ' ' when the move is not a promotion
+} Move;
+
+typedef struct {
+    Move moves[MAX_MOVES];
+    int scores[MAX_MOVES];
+    int count;
+} MoveList;
+
+typedef struct {
+    uint64_t key;
+    uint64_t pawnKey;
+    int rule50;
+    int mg;
+    int eg;
+    int phase;
+} Undo;
+
+typedef struct {
+    char board[8][8];
+    int side;               // side to move, SIDE_WHITE or SIDE_BLACK
+    int kingSquare[2];
+    int material[2];        // non-king material per side
+    uint64_t pawnBits[2];   // pawn bitboards, bit SQUARE(row, col)
+    int rule50;             // plies since the last capture or pawn move
+    uint64_t key;           // Zobrist key of the whole position
+    uint64_t pawnKey;       // Zobrist key of the pawns only
+    int mg;                 // middlegame material + piece-square sum
+    int eg;                 // endgame material + piece-square sum
+    int phase;              // game phase, see evaluate.h
+    int historyLength;
+    Undo history[MAX_GAME_PLY];
+} Position;
+
+extern const Move NO_MOVE;
+
+void engine_init(void);
+
+void position_set_board(Position* pos, char board[8][8], char turn);
+bool position_set_fen(Position* pos, const char* fen);
+void position_to_fen(const Position* pos, char* fen, int size);
+char position_turn(const Position* pos);
+
+int piece_index(char piece);
+int piece_side(char piece);
+int piece_value(char piece);
+bool move_equals(Move a, Move b);
+bool move_is_none(Move move);
+
+int generate_moves(const Position* pos, MoveList* list, bool capturesOnly);
+int generate_legal_moves(Position* pos, MoveList* list);
+uint64_t perft(Position* pos, int depth);
+bool square_attacked(const Position* pos, int sq, int bySide);
+bool in_check(const Position* pos);
+bool make_move(Position* pos, Move move);
+void unmake_move(Position* pos, Move move);
+void make_null_move(Position* pos);
+void unmake_null_move(Position* pos);
+bool has_non_pawn_material(const Position* pos, int side);
+bool is_repetition(const Position* pos);
+int see(const Position* pos, Move move);
+
+void move_to_uci(Move move, char* text);
+void move_to_san(Position* pos, Move move, char* text);
+Move parse_san(Position* pos, const char* text);
+Move parse_uci(Position* pos, const char* text);
+
+#endif
@@ -0,0 +1,324 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "evaluate.h"
+
+int psqtMg[12][64];
+int psqtEg[12][64];
+
+// Indexed like piece_index(): pnbrqk then PNBRQK
+const int phaseWeight[12] = {0, 1, 1, 2, 4, 0, 0, 1, 1, 2, 4, 0};
+
+static const int materialMg[6] = {82, 337, 365, 477, 1025, 0};
+static const int materialEg[6] = {94, 281, 297, 512, 936, 0};
+
+// Piece-square tables for the lowercase side as seen on screen: the first
+// row is row 0 of the board, the top of the screen. The uppercase side uses
+// the same tables mirrored vertically.
+static const int pawnMg[64] = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+     50,  50,  50,  50,  50,  50,  50,  50,
+     10,  10,  20,  30,  30,  20,  10,  10,
+      5,   5,  10,  25,  25,  10,   5,   5,
+      0,   0,   0,  20,  20,   0,   0,   0,
+      5,  -5, -10,   0,   0, -10,  -5,   5,
+      5,  10,  10, -20, -20,  10,  10,   5,
+      0,   0,   0,   0,   0,   0,   0,   0
+};
+
+static const int pawnEg[64] = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+     90,  90,  90,  90,  90,  90,  90,  90,
+     55,  55,  55,  55,  55,  55,  55,  55,
+     30,  30,  30,  30,  30,  30,  30,  30,
+     15,  15,  15,  15,  15,  15,  15,  15,
+      5,   5,   5,   5,   5,   5,   5,   5,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0
+};
+
+static const int knightTable[64] = {
+    -50, -40, -30, -30, -30, -30, -40, -50,
+    -40, -20,   0,   0,   0,   0, -20, -40,
+    -30,   0,  10,  15,  15,  10,   0, -30,
+    -30,   5,  15,  20,  20,  15,   5, -30,
+    -30,   0,  15,  20,  20,  15,   0, -30,
+    -30,   5,  10,  15,  15,  10,   5, -30,
+    -40, -20,   0,   5,   5,   0, -20, -40,
+    -50, -40, -30, -30, -30, -30, -40, -50
+};
+
+static const int bishopTable[64] = {
+    -20, -10, -10, -10, -10, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,  10,  10,   5,   0, -10,
+    -10,   5,   5,  10,  10,   5,   5, -10,
+    -10,   0,  10,  10,  10,  10,   0, -10,
+    -10,  10,  10,  10,  10,  10,  10, -10,
+    -10,   5,   0,   0,   0,   0,   5, -10,
+    -20, -10, -10, -10, -10, -10, -10, -20
+};
+
+static const int rookTable[64] = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+      5,  10,  10,  10,  10,  10,  10,   5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+      0,   0,   0,   5,   5,   0,   0,   0
+};
+
+static const int queenTable[64] = {
+    -20, -10, -10,  -5,  -5, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,   5,   5,   5,   0, -10,
+     -5,   0,   5,   5,   5,   5,   0,  -5,
+      0,   0,   5,   5,   5,   5,   0,  -5,
+    -10,   5,   5,   5,   5,   5,   0, -10,
+    -10,   0,   5,   0,   0,   0,   0, -10,
+    -20, -10, -10,  -5,  -5, -10, -10, -20
+};
+
+static const int kingMg[64] = {
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -20, -30, -30, -40, -40, -30, -30, -20,
+    -10, -20, -20, -20, -20, -20, -20, -10,
+     20,  20,   0,   0,   0,   0,  20,  20,
+     20,  30,  10,   0,   0,  10,  30,  20
+};
+
+static const int kingEg[64] = {
+    -50, -40, -30, -20, -20, -30, -40, -50,
+    -30, -20, -10,   0,   0, -10, -20, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -30,   0,   0,   0,   0, -30, -30,
+    -50, -30, -30, -30, -30, -30, -30, -50
+};
+
+// Pawn structure terms, SIDE_WHITE's point of view
+#define DOUBLED_MG -10
+#define DOUBLED_EG -20
+#define ISOLATED_MG -10
+#define ISOLATED_EG -15
+#define BACKWARD_MG -8
+#define BACKWARD_EG -10
+#define SHELTER_NEAR 10     // shield pawn one row in front of the back row
+#define SHELTER_FAR 5       // shield pawn two rows in front
+
+// Passed pawn bonus by rows advanced from the pawn's starting row
+static const int passedMg[8] = {0, 5, 10, 15, 25, 40, 60, 0};
+static const int passedEg[8] = {0, 10, 20, 35, 60, 90, 130, 0};
+
+// Endgame weight of the kings' distances to the square in front of a passed
+// pawn, per row it has advanced past the third: the defending king counts
+// against it, the own king for it
+#define PASSER_ENEMY_KING 5
+#define PASSER_OWN_KING 2
+
+static uint64_t fileMasks[8];
+static uint64_t adjacentFiles[8];
+static uint64_t aheadRows[2][8];        // rows strictly in front of a row
+static uint64_t passedMasks[2][64];     // enemy pawns that stop a passer
+static uint64_t supportMasks[2][64];    // own pawns level with or behind, adjacent columns
+static uint64_t stopAttackers[2][64];   // enemy pawns attacking the square in front
+
+void eval_init(void) {
+    for (int col = 0; col < 8; col++) {
+        fileMasks[col] = 0x0101010101010101ULL << col;
+    }
+    for (int col = 0; col < 8; col++) {
+        adjacentFiles[col] = (col > 0 ? fileMasks[col - 1] : 0) | (col < 7 ? fileMasks[col + 1] : 0);
+    }
+    for (int row = 0; row < 8; row++) {
+        // SIDE_WHITE pawns advance towards row 0, SIDE_BLACK towards row 7
+        aheadRows[SIDE_WHITE][row] = (1ULL << (row * 8)) - 1;
+        aheadRows[SIDE_BLACK][row] = row == 7 ? 0 : ~((1ULL << ((row + 1) * 8)) - 1);
+    }
+    for (int sq = 0; sq < 64; sq++) {
+        int row = SQUARE_ROW(sq);
+        int col = SQUARE_COL(sq);
+        for (int side = 0; side < 2; side++) {
+            passedMasks[side][sq] = (fileMasks[col] | adjacentFiles[col]) & aheadRows[side][row];
+            supportMasks[side][sq] = adjacentFiles[col] & ~aheadRows[side][row];
+
+            // An enemy pawn two rows ahead on an adjacent column hits the stop square
+            int enemyRow = row + (side == SIDE_WHITE ? -2 : 2);
+            stopAttackers[side][sq] = 0;
+            if (enemyRow >= 0 && enemyRow < 8) {
+                for (int dc = -1; dc <= 1; dc += 2) {
+                    if (col + dc >= 0 && col + dc < 8) {
+                        stopAttackers[side][sq] |= 1ULL << SQUARE(enemyRow, col + dc);
+                    }
+                }
+            }
+        }
+    }
+
+    const int* tablesMg[6] = {pawnMg, knightTable, bishopTable, rookTable, queenTable, kingMg};
+    const int* tablesEg[6] = {pawnEg, knightTable, bishopTable, rookTable, queenTable, kingEg};
+
+    for (int type = 0; type < 6; type++) {
+        for (int sq = 0; sq < 64; sq++) {
+            // Lowercase pieces read the table as drawn, uppercase mirrored
+            psqtMg[type][sq] = materialMg[type] + tablesMg[type][sq];
+            psqtEg[type][sq] = materialEg[type] + tablesEg[type][sq];
+            psqtMg[type + 6][sq] = -(materialMg[type] + tablesMg[type][sq ^ 56]);
+            psqtEg[type + 6][sq] = -(materialEg[type] + tablesEg[type][sq ^ 56]);
+        }
+    }
+}
+
+// Full recomputation, only needed when a position is set up from scratch
+void eval_refresh(Position* pos) {
+    pos->mg = 0;
+    pos->eg = 0;
+    pos->phase = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        char piece = pos->board[SQUARE_ROW(sq)][SQUARE_COL(sq)];
+        if (piece != ' ') {
+            int index = piece_index(piece);
+            pos->mg += psqtMg[index][sq];
+            pos->eg += psqtEg[index][sq];
+            pos->phase += phaseWeight[index];
+        }
+    }
+}
+
+static void evaluate_pawns(const Position* pos, PawnEntry* entry) {
+    memset(entry, 0, sizeof(*entry));
+    entry->key = pos->pawnKey;
+
+    for (int side = 0; side < 2; side++) {
+        int sign = (side == SIDE_WHITE) ? 1 : -1;
+        uint64_t own = pos->pawnBits[side];
+        uint64_t enemy = pos->pawnBits[side ^ 1];
+
+        for (uint64_t bits = own; bits; bits &= bits - 1) {
+            int sq = __builtin_ctzll(bits);
+            int row = SQUARE_ROW(sq);
+            int col = SQUARE_COL(sq);
+            bool blocked = (own & fileMasks[col] & aheadRows[side][row]) != 0;
+
+            if (blocked) {
+                entry->mg += sign * DOUBLED_MG;
+                entry->eg += sign * DOUBLED_EG;
+            }
+            if (!(own & adjacentFiles[col])) {
+                entry->mg += sign * ISOLATED_MG;
+                entry->eg += sign * ISOLATED_EG;
+            } else if (!(own & supportMasks[side][sq]) && (enemy & stopAttackers[side][sq])) {
+                entry->mg += sign * BACKWARD_MG;
+                entry->eg += sign * BACKWARD_EG;
+            }
+            if (!blocked && !(enemy & passedMasks[side][sq])) {
+                int advanced = (side == SIDE_WHITE) ? 6 - row : row - 1;
+                entry->passed[side] |= 1ULL << sq;
+                entry->mg += sign * passedMg[advanced];
+                entry->eg += sign * passedEg[advanced];
+            }
+        }
+
+        // Shield in front of a king standing on its back row
+        int nearRow = (side == SIDE_WHITE) ? 6 : 1;
+        int farRow = (side == SIDE_WHITE) ? 5 : 2;
+        for (int kingCol = 0; kingCol < 8; kingCol++) {
+            int shelter = 0;
+            for (int col = kingCol - 1; col <= kingCol + 1; col++) {
+                if (col < 0 || col > 7) {
+                    continue;
+                }
+                if (own & (1ULL << SQUARE(nearRow, col))) {
+                    shelter += SHELTER_NEAR;
+                } else if (own & (1ULL << SQUARE(farRow, col))) {
+                    shelter += SHELTER_FAR;
+                }
+            }
+            entry->shelter[side][kingCol] = shelter;
+        }
+    }
+}
+
+void pawn_table_clear(PawnTable* table) {
+    memset(table, 0, sizeof(*table));
+}
+
+// A cleared entry has key 0 and all terms 0, which is also the correct entry
+// for a position without pawns, so no separate valid flag is needed
+static const PawnEntry* probe_pawns(const Position* pos, PawnTable* table, PawnEntry* scratch) {
+    if (!table) {
+        evaluate_pawns(pos, scratch);
+        return scratch;
+    }
+    PawnEntry* entry = &table->entries[pos->pawnKey & (PAWN_HASH_SIZE - 1)];
+    table->probes++;
+    if (entry->key == pos->pawnKey) {
+        table->hits++;
+    } else {
+        evaluate_pawns(pos, entry);
+    }
+    return entry;
+}
+
+// Blends the running middlegame and endgame sums, plus the cached pawn
+// structure, by game phase. Promotions can push the phase above PHASE_MAX,
+// so it is clamped. pawnTable may be NULL to evaluate without caching.
+static int square_distance(int a, int b) {
+    int rows = abs(SQUARE_ROW(a) - SQUARE_ROW(b));
+    int cols = abs(SQUARE_COL(a) - SQUARE_COL(b));
+    return rows > cols ? rows : cols;
+}
+
+// How well each king stands to stop or escort the passed pawns, which the
+// pawn table cannot hold since it does not know where the kings are
+static int passer_king_distance(const Position* pos, const PawnEntry* pawns) {
+    int eg = 0;
+    for (int side = 0; side < 2; side++) {
+        int sign = (side == SIDE_WHITE) ? 1 : -1;
+        int ownKing = pos->kingSquare[side];
+        int enemyKing = pos->kingSquare[side ^ 1];
+        for (uint64_t bits = pawns->passed[side]; bits; bits &= bits - 1) {
+            int sq = __builtin_ctzll(bits);
+            int row = SQUARE_ROW(sq);
+            int advanced = (side == SIDE_WHITE) ? 6 - row : row - 1;
+            if (advanced < 3) {
+                continue;
+            }
+            int stop = sq + (side == SIDE_WHITE ? -8 : 8);
+            eg += sign * (advanced - 2) * (PASSER_ENEMY_KING * square_distance(enemyKing, stop)
+                                         - PASSER_OWN_KING * square_distance(ownKing, stop));
+        }
+    }
+    return eg;
+}
+
+int evaluate(const Position* pos, PawnTable* pawnTable) {
+    PawnEntry scratch;
+    const PawnEntry* pawns = probe_pawns(pos, pawnTable, &scratch);
+
+    int mg = pos->mg + pawns->mg;
+    int eg = pos->eg + pawns->eg;
+    if (pawns->passed[SIDE_WHITE] | pawns->passed[SIDE_BLACK]) {
+        eg += passer_king_distance(pos, pawns);
+    }
+
+    int whiteKing = pos->kingSquare[SIDE_WHITE];
+    int blackKing = pos->kingSquare[SIDE_BLACK];
+    if (SQUARE_ROW(whiteKing) == 7) {
+        mg += pawns->shelter[SIDE_WHITE][SQUARE_COL(whiteKing)];
+    }
+    if (SQUARE_ROW(blackKing) == 0) {
+        mg -= pawns->shelter[SIDE_BLACK][SQUARE_COL(blackKing)];
+    }
+
+    int phase = pos->phase < PHASE_MAX ? pos->phase : PHASE_MAX;
+    int score = (mg * phase + eg * (PHASE_MAX - phase)) / PHASE_MAX;
+    return pos->side == SIDE_WHITE ? score : -score;
+}
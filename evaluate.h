@@ -0,0 +1,40 @@
+#ifndef EVALUATE_H
+#define EVALUATE_H
+
+#include "engine.h"
+
+// Game phase runs from PHASE_MAX with all minor and major pieces on the board
+// down to 0 with only kings and pawns left
+#define PHASE_MAX 24
+
+// Middlegame and endgame values of each piece on each square, material
+// included, indexed by piece_index(). Uppercase pieces have negative values
+// so the running sums in Position are always SIDE_WHITE minus SIDE_BLACK.
+extern int psqtMg[12][64];
+extern int psqtEg[12][64];
+extern const int phaseWeight[12];
+
+#define PAWN_HASH_SIZE 8192 // entries, a power of two
+
+// Cached pawn-structure terms for one pawn configuration, keyed by
+// Position.pawnKey. Scores are SIDE_WHITE minus SIDE_BLACK.
+typedef struct {
+    uint64_t key;
+    uint64_t passed[2];     // passed pawn bitboards per side
+    int mg;
+    int eg;
+    signed char shelter[2][8]; // pawn shield per side for a king on each column
+} PawnEntry;
+
+typedef struct {
+    PawnEntry entries[PAWN_HASH_SIZE];
+    uint64_t probes;
+    uint64_t hits;
+} PawnTable;
+
+void eval_init(void);
+void eval_refresh(Position* pos);
+void pawn_table_clear(PawnTable* table);
+int evaluate(const Position* pos, PawnTable* pawnTable);
+
+#endif
@@ -2,8 +2,16 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <stdbool.h>
+#include <string.h>
 #include <SDL2/SDL_ttf.h>
 #include "functions.h"
+#include "analysis.h"
+#include "mate.h"
+#include "tb.h"
+#include "book.h"
+#include "text.h"
+#include "scheduler.h"
+#include "resources.h"
 #include <SDL2/SDL_mixer.h> // Include SDL2_mixer header
 
 // Define sound effects
@@ -12,8 +20,6 @@ Mix_Chunk *invalid_sound = NULL;
 Mix_Chunk *promote_sound = NULL;
 Mix_Chunk *menu_sound = NULL;
 
-#define WINDOW_WIDTH 800
-#define WINDOW_HEIGHT 640
 #define BOARD_SIZE 8
 
 // Define player colors
@@ -22,9 +28,51 @@ Mix_Chunk *menu_sound = NULL;
 // Initialize the turn
 extern char turn; // Start with white player
 
+// Background engine analysis shown over the board, toggled with the A key
+static Analysis analysis;
+static bool analysisEnabled = false;
+static int analysisLines = ANALYSIS_DEFAULT_LINES;
+
+// Search counters of the analysis, toggled with the S key and refreshed
+// this often while the analysis runs
+static bool statsEnabled = false;
+#define STATS_REFRESH_MS 100
+
+// Length of the slide of a moved piece and the fade of what it took
+#define MOVE_ANIMATION_MS 160
+
+// Wakes and paces every screen's loop, see scheduler.h
+static Scheduler scheduler;
+
+// Where everything goes at the current output size, and the fonts and
+// pieces of the last few scales, see update_layout
+static Layout layout;
+static ScaledAssets scaledAssets[MAX_CACHED_SCALES];
+static Uint32 scaledAssetsClock = 0;
+
+// Mate finder started with the M key, solved on its own thread so the board
+// stays responsive; the result is shown under the turn text
+static SDL_Thread* mateThread = NULL;
+static SDL_atomic_t mateStop;
+static SDL_atomic_t mateDone;
+static Position matePosition;
+static MateResult mateResult;
+static char mateText[256] = "";
+
+// Exact result from the endgame tables, shown while one covers the position
+static char tablebaseText[64] = "";
+
+// Opening book moves for the position, shown while the book has any; the B
+// key plays one of them for the side to move
+static Book book;
+static char bookText[160] = "";
 
 
 SDL_Window* create_window(const char* title, int width, int height) {
+    // Draw at the display's real resolution on Windows instead of letting
+    // it upscale a 96 dpi window
+    SDL_SetHint(SDL_HINT_WINDOWS_DPI_AWARENESS, "permonitorv2");
+
     // Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
         printf("Error initializing SDL: %s\n", SDL_GetError());
@@ -38,7 +86,7 @@ SDL_Window* create_window(const char* title, int width, int height) {
         SDL_WINDOWPOS_CENTERED,
         width,
         height,
-        SDL_WINDOW_BORDERLESS
+        SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI
     );
 
     // Check if the window was created successfully
@@ -48,177 +96,250 @@ SDL_Window* create_window(const char* title, int width, int height) {
         return NULL;
     }
 
+    // Half the size is as small as the text stays readable
+    SDL_SetWindowMinimumSize(window, width / 2, height / 2);
     return window;
 }
 
+void load_opening_book(const char* path) {
+    if (book_open(&book, path)) {
+        printf("Opened book %s with %llu entries\n", path, (unsigned long long)book.count);
+    }
+}
+
+void free_opening_book(void) {
+    book_close(&book);
+}
+
 void load_sounds() {
-    move_sound = Mix_LoadWAV("move-self.mp3"); 
-    invalid_sound = Mix_LoadWAV("invalid_sound.mp3"); 
-    promote_sound = Mix_LoadWAV("promote.mp3"); 
-    menu_sound = Mix_LoadWAV("menu.mp3");
+    move_sound = resource_sound("move-self.mp3"); 
+    invalid_sound = resource_sound("invalid_sound.mp3"); 
+    promote_sound = resource_sound("promote.mp3"); 
+    menu_sound = resource_sound("menu.mp3");
+}
+
+void free_sounds(void) {
+    resource_release(move_sound);
+    resource_release(invalid_sound);
+    resource_release(promote_sound);
+    resource_release(menu_sound);
+    move_sound = invalid_sound = promote_sound = menu_sound = NULL;
 }
 
+// Draws from the font's glyph atlas, so nothing is rasterized or uploaded
+// once the atlas exists
 void render_text(SDL_Renderer* renderer, TTF_Font* font, const char* text, int x, int y) {
     SDL_Color color = {0, 0, 0, 255}; // Black color for text
-    SDL_Surface* surface = TTF_RenderText_Solid(font, text, color);
-    if (!surface) {
-        printf("Error rendering text surface: %s\n", TTF_GetError());
-        return;
-    }
-    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-    if (!texture) {
-        printf("Error creating texture from surface: %s\n", SDL_GetError());
-        SDL_FreeSurface(surface);
-        return;
-    }
-    SDL_Rect textRect = {x, y, 0, 0}; // Position of text
-    SDL_QueryTexture(texture, NULL, NULL, &textRect.w, &textRect.h); // Get width and height of text
-    SDL_RenderCopy(renderer, texture, NULL, &textRect);
-    SDL_FreeSurface(surface);
-    SDL_DestroyTexture(texture);
+    text_draw(renderer, font, text, x, y, color);
 }
 
-void draw_board(SDL_Renderer* renderer, TTF_Font* font) {
-    // Define the square size based on the board size
-    int square_width = WINDOW_WIDTH / BOARD_SIZE;
-    int square_height = WINDOW_HEIGHT / BOARD_SIZE;
+// Sizes for a scale of steps/LAYOUT_STEPS of the base layout. Squares are
+// whole pixels, so the board can be a little smaller than the scale says.
+static void layout_sizes(Layout* l, int steps) {
+    l->scaleSteps = steps;
+    l->squareW = BASE_WIDTH / BOARD_SIZE * steps / LAYOUT_STEPS;
+    l->squareH = BASE_HEIGHT / BOARD_SIZE * steps / LAYOUT_STEPS;
 
-    // Draw the chess board
-    for (int row = 0; row < BOARD_SIZE; row++) {
-        for (int col = 0; col < BOARD_SIZE; col++) {
-            // Alternate between light and dark squares
-            if ((row + col) % 2 == 0) {
-                SDL_SetRenderDrawColor(renderer, 177, 228,185, 255);
-            } else {
-                SDL_SetRenderDrawColor(renderer, 112, 162, 163, 255);
-            }
+    // Set the desired scaling factor for the chess pieces
+    float scaling_factor = 0.6f; // Adjust this value as needed
+    l->pieceW = (int)(l->squareW * scaling_factor);
+    l->pieceH = (int)(l->squareH * scaling_factor);
+}
 
-            SDL_Rect square = {
-                col * square_width,
-                row * square_height,
-                square_width,
-                square_height
-            };
+// A length of the base layout at the current scale
+static int scaled(int base) {
+    return base * layout.scaleSteps / LAYOUT_STEPS;
+}
 
-            SDL_RenderFillRect(renderer, &square);
-        }
+// Fills one square in its light or dark colour, with the board's top left
+// corner at origin
+static void fill_square(SDL_Renderer* renderer, int row, int col, SDL_Point origin) {
+    // Alternate between light and dark squares
+    if ((row + col) % 2 == 0) {
+        SDL_SetRenderDrawColor(renderer, 177, 228,185, 255);
+    } else {
+        SDL_SetRenderDrawColor(renderer, 112, 162, 163, 255);
     }
 
-    render_text(renderer, font, (turn == 'W' ? "Black's Turn" : "White's Turn"), 5, 5);
+    SDL_Rect square = {
+        origin.x + col * layout.squareW,
+        origin.y + row * layout.squareH,
+        layout.squareW,
+        layout.squareH
+    };
 
-    SDL_RenderPresent(renderer);
+    SDL_RenderFillRect(renderer, &square);
 }
 
-void load_chess_pieces(SDL_Renderer* renderer, SDL_Texture** textures) {
-    const char* image_files[] = {
-        "images/wp.png",
-        "images/bp.png",
-        "images/wk.png",
-        "images/bk.png",
-        "images/wq.png",
-        "images/bq.png",
-        "images/wr.png",
-        "images/br.png",
-        "images/wb.png",
-        "images/bb.png",
-        "images/wh.png",
-        "images/bh.png"
+// Where the piece on a square is drawn, centred in the square
+static SDL_FRect piece_rect(int row, int col, SDL_Point origin) {
+    SDL_FRect dst_rect = {
+        (float)(origin.x + col * layout.squareW + (layout.squareW - layout.pieceW) / 2),
+        (float)(origin.y + row * layout.squareH + (layout.squareH - layout.pieceH) / 2),
+        (float)layout.pieceW,
+        (float)layout.pieceH
     };
-
-    // Load each texture and check for errors
-    for (int i = 0; i < 12; i++) {
-        textures[i] = IMG_LoadTexture(renderer, image_files[i]);
-        if (!textures[i]) {
-            printf("Error loading texture from %s: %s\n", image_files[i], SDL_GetError());
-        } else {
-            printf("Successfully loaded texture from %s\n", image_files[i]);
-        }
-    }
+    return dst_rect;
 }
 
-void render_chess_pieces(SDL_Renderer* renderer, SDL_Texture** textures, char board[8][8]) {
-    int square_width = WINDOW_WIDTH / BOARD_SIZE;
-    int square_height = WINDOW_HEIGHT / BOARD_SIZE;
-
-    // Set the desired scaling factor for the chess pieces
-    float scaling_factor = 0.6f; // Adjust this value as needed
-
-    // Calculate the scaled width and height of the chess pieces
-    int scaled_width = square_width * scaling_factor;
-    int scaled_height = square_height * scaling_factor;
+static SDL_Point board_origin(void) {
+    SDL_Point origin = {layout.board.x, layout.board.y};
+    return origin;
+}
 
-    SDL_Rect dst_rect;
+// Drawn every frame, so kept whole in the text cache
+static void draw_turn_label(SDL_Renderer* renderer, TTF_Font* font) {
+    SDL_Color color = {0, 0, 0, 255};
+    text_draw_cached(renderer, font, (turn == 'W' ? "Black's Turn" : "White's Turn"),
+                     layout.board.x + scaled(5), layout.board.y + scaled(5), color);
+}
 
+void draw_board(SDL_Renderer* renderer, TTF_Font* font) {
+    // Draw the chess board
     for (int row = 0; row < BOARD_SIZE; row++) {
         for (int col = 0; col < BOARD_SIZE; col++) {
-            // Calculate the x and y positions to center the image in the tile
-            dst_rect.x = col * square_width + (square_width - scaled_width) / 2;
-            dst_rect.y = row * square_height + (square_height - scaled_height) / 2;
-            dst_rect.w = scaled_width;
-            dst_rect.h = scaled_height;
-
-            SDL_Texture* texture = NULL;
-            char piece = board[row][col];
-
-            switch (piece) {
-                case 'p':
-                    texture = textures[0];
-                    break;
-
-                case 'P':
-                    texture = textures[1];
-                    break;
-
-                case 'k':
-                    texture = textures[2];
-                    break;
-
-                case 'K':
-                    texture = textures[3];
-                    break;
-
-                case 'q':
-                    texture = textures[4];
-                    break;
-
-                case 'Q':
-                    texture = textures[5];
-                    break;
-
-                case 'r':
-                    texture = textures[6];
-                    break;
-
-                case 'R':
-                    texture = textures[7];
-                    break;
-
-                case 'b':
-                    texture = textures[8];
-                    break;
-
-                case 'B':
-                    texture = textures[9];
-                    break;
+            fill_square(renderer, row, col, board_origin());
+        }
+    }
+    draw_turn_label(renderer, font);
+}
 
-                case 'n':
-                    texture = textures[10];
-                    break;
+// Queues every piece and draws them from the atlas in one batch
+void render_chess_pieces(SDL_Renderer* renderer, const PieceAtlas* pieces, char board[8][8]) {
+    SpriteBatch batch;
+    sprite_batch_begin(&batch, pieces);
+    for (int row = 0; row < BOARD_SIZE; row++) {
+        for (int col = 0; col < BOARD_SIZE; col++) {
+            SDL_FRect dst_rect = piece_rect(row, col, board_origin());
+            sprite_batch_add(&batch, renderer, board[row][col], &dst_rect, 255);
+        }
+    }
+    sprite_batch_flush(&batch, renderer);
+}
 
-                case 'N':
-                    texture = textures[11];
-                    break;
+// Brings the cached board texture up to date with board, redrawing only
+// the squares whose piece changed since the last update: after a move that
+// is the from and to squares and any captured piece. Returns false when
+// the renderer cannot draw into textures, and the board has to be drawn
+// directly every frame.
+static bool update_board_cache(App* app, char board[8][8]) {
+    BoardCache* cache = &app->boardCache;
+    SDL_Renderer* renderer = app->renderer;
+    // A new scale needs a texture of the new board size
+    if (cache->texture && (cache->w != layout.board.w || cache->h != layout.board.h)) {
+        resource_release(cache->texture);
+        cache->texture = NULL;
+    }
+    if (!cache->texture) {
+        if (cache->unsupported) {
+            return false;
+        }
+        cache->texture = resource_create_texture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                                 layout.board.w, layout.board.h, "board");
+        if (!cache->texture) {
+            printf("Drawing the board without a cache: %s\n", SDL_GetError());
+            cache->unsupported = true;
+            return false;
+        }
+        cache->w = layout.board.w;
+        cache->h = layout.board.h;
+        cache->valid = false;
+    }
 
-                default:
-                    break;
+    // Squares are opaque and each piece stays inside its square, so every
+    // fill can go first and the pieces after in one batch
+    SpriteBatch batch;
+    sprite_batch_begin(&batch, app->pieces);
+    bool drawing = false;
+    for (int row = 0; row < BOARD_SIZE; row++) {
+        for (int col = 0; col < BOARD_SIZE; col++) {
+            if (cache->valid && cache->shown[row][col] == board[row][col]) {
+                continue;
             }
-
-            if (texture) {
-                SDL_RenderCopy(renderer, texture, NULL, &dst_rect);
+            if (!drawing) {
+                SDL_SetRenderTarget(renderer, cache->texture);
+                drawing = true;
             }
+            SDL_Point origin = {0, 0};
+            fill_square(renderer, row, col, origin);
+            SDL_FRect dst_rect = piece_rect(row, col, origin);
+            sprite_batch_add(&batch, renderer, board[row][col], &dst_rect, 255);
+            cache->shown[row][col] = board[row][col];
         }
     }
-    SDL_RenderPresent(renderer);
+    if (drawing) {
+        sprite_batch_flush(&batch, renderer);
+        SDL_SetRenderTarget(renderer, NULL);
+    }
+    cache->valid = true;
+    return true;
+}
+
+static void free_board_cache(BoardCache* cache) {
+    resource_release(cache->texture);
+    memset(cache, 0, sizeof(*cache));
+}
+
+void draw_analysis_panel(SDL_Renderer* renderer, TTF_Font* font, const AnalysisSnapshot* snapshot) {
+    int line_height = scaled(18);
+    int shown = snapshot->lineCount > 0 ? snapshot->lineCount : 1;
+    int height = (shown + 1) * line_height + scaled(10);
+    SDL_Rect panel = {layout.board.x, layout.board.y + layout.board.h - height, layout.board.w, height};
+    int x = panel.x + scaled(5);
+    int y = panel.y + scaled(5);
+
+    // Translucent so the pieces underneath stay visible
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 210);
+    SDL_RenderFillRect(renderer, &panel);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+
+    char text[ANALYSIS_TEXT + 8];
+    int knps = snapshot->elapsed > 0 ? (int)(snapshot->nodes / snapshot->elapsed) : 0;
+    snprintf(text, sizeof(text), "Analysis  depth %d  %llu nodes  %d knps  (A: close, 1-5: lines)",
+             snapshot->depth, (unsigned long long)snapshot->nodes, knps);
+    render_text(renderer, font, text, x, y);
+
+    if (snapshot->lineCount == 0) {
+        render_text(renderer, font, "Searching...", x, y + line_height);
+    }
+    for (int i = 0; i < snapshot->lineCount; i++) {
+        snprintf(text, sizeof(text), "%d. %s", i + 1, snapshot->text[i]);
+        render_text(renderer, font, text, x, y + (i + 1) * line_height);
+    }
+}
+
+// Counters of the running or last search in the top right corner
+void draw_stats_overlay(SDL_Renderer* renderer, TTF_Font* font, const SearchStats* stats) {
+    int line_height = scaled(18);
+    SDL_Rect panel = {layout.board.x + layout.board.w - scaled(290), layout.board.y + scaled(5),
+                      scaled(285), 7 * line_height + scaled(10)};
+
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 210);
+    SDL_RenderFillRect(renderer, &panel);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+
+    char lines[7][96];
+    snprintf(lines[0], sizeof(lines[0]), "Search stats  (S: close)");
+    snprintf(lines[1], sizeof(lines[1]), "Depth %d  %llu nodes", stats->depth, (unsigned long long)stats->nodes);
+    snprintf(lines[2], sizeof(lines[2]), "Quiescence %.1f%%  %llu nps",
+             stats->nodes ? 100.0 * stats->qnodes / stats->nodes : 0.0, (unsigned long long)search_nps(stats));
+    snprintf(lines[3], sizeof(lines[3]), "TT %llu probes  %.1f%% hits", (unsigned long long)stats->ttProbes,
+             search_tt_hit_rate(stats));
+    snprintf(lines[4], sizeof(lines[4]), "First-move cutoffs %.1f%%", search_first_move_cutoff_rate(stats));
+    snprintf(lines[5], sizeof(lines[5]), "Branching factor %.2f", search_branching_factor(stats, stats->depth));
+
+    // Time of the last few iterations, each about the branching factor
+    // times the one before
+    int length = snprintf(lines[6], sizeof(lines[6]), "Iterations");
+    for (int depth = stats->depth > 3 ? stats->depth - 3 : 1; depth <= stats->depth; depth++) {
+        int ms = stats->iterationTime[depth] - stats->iterationTime[depth - 1];
+        length += snprintf(lines[6] + length, sizeof(lines[6]) - length, "  d%d %d ms", depth, ms);
+    }
+    for (int i = 0; i < 7; i++) {
+        render_text(renderer, font, lines[i], panel.x + scaled(5), panel.y + scaled(5) + i * line_height);
+    }
 }
 
 bool validate_pawn_move(char board[8][8], int fromRow, int fromCol, int toRow, int toCol, bool *promoted) {
@@ -483,27 +604,81 @@ bool validate_move(char board[8][8], int fromRow, int fromCol, int toRow, int to
 
 
 
-void draw_button(SDL_Renderer* renderer, TTF_Font* font, Button* button) {
-    SDL_Color textColor = {255, 255, 255}; // White color for text
-    SDL_Surface* surface = TTF_RenderText_Solid(font, button->text, textColor);
-    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-    SDL_FreeSurface(surface);
+void free_button(Button* button) {
+    for (int i = 0; i < BUTTON_STATES; i++) {
+        resource_release(button->labels[i]);
+        button->labels[i] = NULL;
+    }
+    button->labelFont = NULL;
+    button->labelText[0] = '\0';
+}
+
+// Renders the label in every look: white, highlighted under the mouse and
+// dimmed while pressed
+static void render_button_labels(SDL_Renderer* renderer, TTF_Font* font, Button* button) {
+    static const SDL_Color colors[BUTTON_STATES] = {
+        {255, 255, 255, 255},
+        {255, 215, 0, 255},
+        {170, 170, 170, 255}
+    };
+    free_button(button);
+    for (int i = 0; i < BUTTON_STATES; i++) {
+        SDL_Surface* surface = TTF_RenderText_Solid(font, button->text, colors[i]);
+        if (!surface) {
+            printf("Error rendering button label: %s\n", TTF_GetError());
+            continue;
+        }
+        button->labels[i] = resource_texture_from_surface(renderer, surface, button->text);
+        SDL_FreeSurface(surface);
+    }
+    button->labelFont = font;
+    snprintf(button->labelText, sizeof(button->labelText), "%s", button->text);
+    if (button->labels[BUTTON_NORMAL]) {
+        SDL_QueryTexture(button->labels[BUTTON_NORMAL], NULL, NULL, &(button->rect.w), &(button->rect.h));
+    }
+}
 
-    SDL_QueryTexture(texture, NULL, NULL, &(button->rect.w), &(button->rect.h));
-    SDL_RenderCopy(renderer, texture, NULL, &(button->rect));
+// Only copies the label once it has been rendered for this text and font
+void draw_button(SDL_Renderer* renderer, TTF_Font* font, Button* button) {
+    if (button->labelFont != font || strcmp(button->labelText, button->text) != 0) {
+        render_button_labels(renderer, font, button);
+    }
+    int state = button->pressed ? BUTTON_PRESSED : (button->hover ? BUTTON_HOVER : BUTTON_NORMAL);
+    SDL_Texture* label = button->labels[state] ? button->labels[state] : button->labels[BUTTON_NORMAL];
+    if (label) {
+        SDL_RenderCopy(renderer, label, NULL, &(button->rect));
+    }
+}
 
-    SDL_DestroyTexture(texture);
+static bool button_contains(const Button* button, int mouseX, int mouseY) {
+    return mouseX >= button->rect.x && mouseX <= button->rect.x + button->rect.w &&
+           mouseY >= button->rect.y && mouseY <= button->rect.y + button->rect.h;
 }
 
 bool handle_button_click(Button* button, int mouseX, int mouseY) {
-    if (mouseX >= button->rect.x && mouseX <= button->rect.x + button->rect.w &&
-        mouseY >= button->rect.y && mouseY <= button->rect.y + button->rect.h) {
+    if (button_contains(button, mouseX, mouseY)) {
         button->clicked = true;
         return true;
     }
     return false;
 }
 
+// Tracks hover and press from mouse events; true when the look changed
+bool update_button_state(Button* button, const SDL_Event* event) {
+    bool hover = button->hover;
+    bool pressed = button->pressed;
+    if (event->type == SDL_MOUSEMOTION) {
+        button->hover = button_contains(button, event->motion.x, event->motion.y);
+        button->pressed = button->pressed && button->hover;
+    } else if (event->type == SDL_MOUSEBUTTONDOWN && event->button.button == SDL_BUTTON_LEFT) {
+        button->hover = button_contains(button, event->button.x, event->button.y);
+        button->pressed = button->hover;
+    } else if (event->type == SDL_MOUSEBUTTONUP && event->button.button == SDL_BUTTON_LEFT) {
+        button->pressed = false;
+    }
+    return hover != button->hover || pressed != button->pressed;
+}
+
 void reset_board(char board[8][8]) {
     char initial_board[8][8] = {
         {'R', 'N', 'B', 'Q', 'K', 'B', 'N', 'R'},
@@ -520,282 +695,793 @@ void reset_board(char board[8][8]) {
     turn = BLACK;
 }
 
+static int mate_thread(void* data) {
+    (void)data;
+    mate_search(&matePosition, MATE_MAX_MOVES, MATE_DEFAULT_NODES, &mateStop, &mateResult);
+    SDL_AtomicSet(&mateDone, 1);
+    scheduler_wake();
+    return 0;
+}
 
-bool menu_screen(TTF_Font* font, SDL_Renderer* renderer){
+static void stop_mate_search(void) {
+    if (mateThread) {
+        SDL_AtomicSet(&mateStop, 1);
+        SDL_WaitThread(mateThread, NULL);
+        mateThread = NULL;
+    }
+    mateText[0] = '\0';
+}
 
-    SDL_Color backgroundColor = {0, 0, 0, 255};
-    SDL_SetRenderDrawColor(renderer, backgroundColor.r, backgroundColor.g, backgroundColor.b, backgroundColor.a);
-    SDL_RenderClear(renderer);
+static void start_mate_search(char board[8][8]) {
+    stop_mate_search();
+    position_set_board(&matePosition, board, turn);
+    SDL_AtomicSet(&mateStop, 0);
+    SDL_AtomicSet(&mateDone, 0);
+    mateThread = SDL_CreateThread(mate_thread, "mate", NULL);
+    if (mateThread) {
+        snprintf(mateText, sizeof(mateText), "Searching for mate...");
+    } else {
+        snprintf(mateText, sizeof(mateText), "Error starting the mate search: %s", SDL_GetError());
+    }
+}
 
-    SDL_Color textColor = {255, 255, 255}; // White color for text
+// Refreshes the tablebase and book lines for the position on the board
+static void update_position_text(char board[8][8]) {
+    static Position pos;
+    TablebaseResult result;
+    BookMove moves[MAX_BOOK_MOVES];
+    position_set_board(&pos, board, turn);
 
-    Button startButton = {{WINDOW_WIDTH / 2 - 110, WINDOW_HEIGHT / 2 - 100, 100, 30}, "Start Game", false};
-    Button exitButton = {{WINDOW_WIDTH / 2 - 95, WINDOW_HEIGHT / 2 - 25, 100, 30}, "Exit Game", false};
-    
+    tablebaseText[0] = '\0';
+    if (tb_probe(&pos, &result)) {
+        tb_format_result(&pos, &result, tablebaseText, sizeof(tablebaseText));
+    }
+    bookText[0] = '\0';
+    int count = book_probe(&book, &pos, moves, MAX_BOOK_MOVES);
+    if (count > 0) {
+        book_format_moves(&pos, moves, count, bookText, sizeof(bookText));
+    }
+}
 
-    SDL_Event event;
-    bool running = true;
-    bool start_clicked = false;
+// Plays a weighted book move for the side to move into played; false out
+// of book
+static bool play_book_move(char board[8][8], Move* played) {
+    static Position pos;
+    Move move;
+    position_set_board(&pos, board, turn);
+    if (!book_pick(&book, &pos, &move)) {
+        return false;
+    }
+    *played = move;
+    int fromRow = SQUARE_ROW(move.from), fromCol = SQUARE_COL(move.from);
+    int toRow = SQUARE_ROW(move.to), toCol = SQUARE_COL(move.to);
+    board[toRow][toCol] = move.promotion != ' ' ? move.promotion : move.piece;
+    board[fromRow][fromCol] = ' ';
+    turn = (turn == WHITE) ? BLACK : WHITE;
+    return true;
+}
 
-    while (running) {
-        while (SDL_PollEvent(&event)) {
-            if (event.type == SDL_QUIT) {
-                running = false;
-            } else if (event.type == SDL_MOUSEBUTTONDOWN) {
-                int mouseX, mouseY;
-                SDL_GetMouseState(&mouseX, &mouseY);
-
-                // Check if the mouse click is inside the button rectangles
-                if (handle_button_click(&startButton, mouseX, mouseY)) {
-                    Mix_PlayChannel(-1, menu_sound, 0);
-                    start_clicked = true;
-                    running = false;
-                } else if (handle_button_click(&exitButton, mouseX, mouseY)) {
-                    running = false;
-                }
+// Starts showing a move already made on the board; every frame until it
+// ends draws at the display's refresh rate
+static void start_move_animation(App* app, Move move) {
+    app->animation.active = true;
+    app->animation.move = move;
+    app->animation.start = SDL_GetPerformanceCounter();
+    scheduler_animate(&scheduler, true);
+    scheduler_invalidate(&scheduler);
+}
+
+static void stop_move_animation(App* app) {
+    if (app->animation.active) {
+        app->animation.active = false;
+        scheduler_animate(&scheduler, false);
+        scheduler_invalidate(&scheduler);
+    }
+}
+
+static double move_animation_ms(const App* app) {
+    Uint64 elapsed = SDL_GetPerformanceCounter() - app->animation.start;
+    return elapsed * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+// Ends the animation once it has run its time, or as soon as a menu covers
+// the board, so no frames are drawn for a board nobody sees
+static void tick_move_animation(App* app, Scene scene) {
+    if (!app->animation.active) {
+        return;
+    }
+    if (move_animation_ms(app) >= MOVE_ANIMATION_MS || (scene != SCENE_GAME && scene != SCENE_GAME_OVER)) {
+        stop_move_animation(app);
+    }
+}
+
+// The moving sprites over the cached board: the captured piece fading on
+// the target square and the moved piece on its way there, eased so it
+// settles gently
+static void draw_move_animation(App* app) {
+    const Move* move = &app->animation.move;
+    float t = (float)SDL_min(move_animation_ms(app) / MOVE_ANIMATION_MS, 1.0);
+    float progress = 1.0f - (1.0f - t) * (1.0f - t);
+
+    SDL_Point origin = board_origin();
+    SDL_FRect from = piece_rect(SQUARE_ROW(move->from), SQUARE_COL(move->from), origin);
+    SDL_FRect to = piece_rect(SQUARE_ROW(move->to), SQUARE_COL(move->to), origin);
+    SDL_FRect at = {from.x + (to.x - from.x) * progress, from.y + (to.y - from.y) * progress, to.w, to.h};
+
+    SpriteBatch batch;
+    sprite_batch_begin(&batch, app->pieces);
+    if (move->captured != ' ') {
+        sprite_batch_add(&batch, app->renderer, move->captured, &to, (Uint8)(255 * (1.0f - progress)));
+    }
+    sprite_batch_add(&batch, app->renderer, move->piece, &at, 255);
+    sprite_batch_flush(&batch, app->renderer);
+}
+
+// Draws the game: board, pieces, result lines and the open panels. The
+// main loop presents the frame.
+static void redraw_game(App* app) {
+    SDL_Renderer* renderer = app->renderer;
+    TTF_Font* font = app->font;
+
+    // While a move animates, the board underneath has its target square
+    // empty and only the moving sprites are drawn each frame
+    char (*board)[8] = app->board;
+    char still[8][8];
+    if (app->animation.active) {
+        memcpy(still, app->board, sizeof(still));
+        still[SQUARE_ROW(app->animation.move.to)][SQUARE_COL(app->animation.move.to)] = ' ';
+        board = still;
+    }
+    if (update_board_cache(app, board)) {
+        SDL_RenderCopy(renderer, app->boardCache.texture, NULL, &layout.board);
+        draw_turn_label(renderer, font);
+    } else {
+        draw_board(renderer, font);
+        render_chess_pieces(renderer, app->pieces, board);
+    }
+    if (app->animation.active) {
+        draw_move_animation(app);
+    }
+    int x = layout.board.x + scaled(5);
+    if (mateText[0] != '\0') {
+        render_text(renderer, font, mateText, x, layout.board.y + scaled(25));
+    }
+    if (tablebaseText[0] != '\0') {
+        render_text(renderer, font, tablebaseText, x, layout.board.y + scaled(45));
+    }
+    if (bookText[0] != '\0') {
+        render_text(renderer, font, bookText, x, layout.board.y + scaled(65));
+    }
+    if (analysisEnabled) {
+        draw_analysis_panel(renderer, font, &app->snapshot);
+    }
+    if (statsEnabled) {
+        SearchStats stats;
+        analysis_stats(&analysis, &stats);
+        draw_stats_overlay(renderer, font, &stats);
+    }
+}
+
+static Scene current_scene(const App* app) {
+    return app->stack[app->depth - 1];
+}
+
+static void push_scene(App* app, Scene scene) {
+    if (app->depth < MAX_SCENES) {
+        app->stack[app->depth++] = scene;
+    }
+    scheduler_invalidate(&scheduler);
+}
+
+static void pop_scene(App* app) {
+    if (app->depth > 0) {
+        app->depth--;
+    }
+    scheduler_invalidate(&scheduler);
+}
+
+// Replaces the whole stack with one scene
+static void set_scene(App* app, Scene scene) {
+    app->depth = 0;
+    push_scene(app, scene);
+}
+
+// Starts play on the position on the board, after the menu or a new game
+static void enter_game(App* app) {
+    app->selectedRow = -1;
+    app->selectedCol = -1;
+    app->selectedPiece = ' ';
+    stop_move_animation(app);
+    stop_mate_search();
+    update_position_text(app->board);
+    if (analysisEnabled) {
+        analysis_start(&analysis, app->board, turn, analysisLines);
+    }
+    set_scene(app, SCENE_GAME);
+}
+
+// The game is over when a king has been taken or the side to move has no
+// legal move; fills resultText and returns true then
+static bool check_game_over(App* app) {
+    bool kings[2] = {false, false};
+    for (int row = 0; row < BOARD_SIZE; row++) {
+        for (int col = 0; col < BOARD_SIZE; col++) {
+            if (app->board[row][col] == 'k') {
+                kings[SIDE_WHITE] = true;
+            } else if (app->board[row][col] == 'K') {
+                kings[SIDE_BLACK] = true;
             }
         }
-    
-        // Clear screen
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        SDL_RenderClear(renderer);
+    }
+    if (!kings[SIDE_WHITE] || !kings[SIDE_BLACK]) {
+        snprintf(app->resultText, sizeof(app->resultText), "%s wins", kings[SIDE_WHITE] ? "White" : "Black");
+        return true;
+    }
 
-        
-        draw_button(renderer, font, &startButton);
-        draw_button(renderer, font, &exitButton);
-        
-        
+    static Position pos;
+    MoveList legal;
+    position_set_board(&pos, app->board, turn);
+    if (generate_legal_moves(&pos, &legal) > 0) {
+        return false;
+    }
+    if (in_check(&pos)) {
+        snprintf(app->resultText, sizeof(app->resultText), "Checkmate, %s wins", pos.side == SIDE_WHITE ? "Black" : "White");
+    } else {
+        snprintf(app->resultText, sizeof(app->resultText), "Stalemate");
+    }
+    return true;
+}
 
-        SDL_RenderPresent(renderer);
+// Everything that follows a completed move, promotion included
+static void finish_move(App* app) {
+    // A mate result no longer applies after a move
+    stop_mate_search();
+    update_position_text(app->board);
 
-    }    
+    // Analyse the new position
+    if (analysisEnabled) {
+        analysis_start(&analysis, app->board, turn, analysisLines);
+    }
+    if (check_game_over(app)) {
+        printf("%s\n", app->resultText);
+        analysis_stop(&analysis);
+        push_scene(app, SCENE_GAME_OVER);
+    }
+    scheduler_invalidate(&scheduler);
+    printf("Current player's turn: %c\n", turn);
+}
 
-    return start_clicked;
+// Tracks hover and press for a scene's buttons; redraws when a look changed
+static void update_buttons(Button* buttons, int count, const SDL_Event* event) {
+    bool changed = false;
+    for (int i = 0; i < count; i++) {
+        changed = update_button_state(&buttons[i], event) || changed;
+    }
+    if (changed) {
+        scheduler_invalidate(&scheduler);
+    }
+}
 
+// Index of the button under a left click, -1 for none
+static int clicked_button(Button* buttons, int count, const SDL_Event* event) {
+    if (event->type != SDL_MOUSEBUTTONDOWN || event->button.button != SDL_BUTTON_LEFT) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (handle_button_click(&buttons[i], event->button.x, event->button.y)) {
+            return i;
+        }
+    }
+    return -1;
 }
 
-void show_popup_menu(SDL_Renderer* renderer, TTF_Font* font, TTF_Font* popUp_font, SDL_Texture** textures, char board[8][8], SDL_Window* window) {
-    SDL_Color backgroundColor = {0, 0, 0, 255};
-    SDL_SetRenderDrawColor(renderer, backgroundColor.r, backgroundColor.g, backgroundColor.b, backgroundColor.a);
-    SDL_RenderClear(renderer);
+static void draw_buttons(SDL_Renderer* renderer, TTF_Font* font, Button* buttons, int count) {
+    for (int i = 0; i < count; i++) {
+        draw_button(renderer, font, &buttons[i]);
+    }
+}
 
-    SDL_Color textColor = {255, 255, 255}; // White color for text
+static void menu_event(App* app, const SDL_Event* event) {
+    update_buttons(app->menuButtons, 2, event);
+    switch (clicked_button(app->menuButtons, 2, event)) {
+        case 0:
+            Mix_PlayChannel(-1, menu_sound, 0);
+            enter_game(app);
+            break;
+        case 1:
+            app->depth = 0;
+            break;
+        default:
+            break;
+    }
+}
 
-    Button resumeButton = {{WINDOW_WIDTH / 2 - 75, WINDOW_HEIGHT / 2 - 100, 100, 30}, "Resume", false};
-    Button newGameButton = {{WINDOW_WIDTH / 2 - 75, WINDOW_HEIGHT / 2 - 50, 100, 30}, "New Game", false};
-    Button exitButton = {{WINDOW_WIDTH / 2 - 75, WINDOW_HEIGHT / 2, 100, 30}, "Exit", false};
+static void pause_event(App* app, const SDL_Event* event) {
+    update_buttons(app->pauseButtons, 3, event);
+    switch (clicked_button(app->pauseButtons, 3, event)) {
+        case 0:
+            printf("Resuming Game\n");
+            Mix_PlayChannel(-1, menu_sound, 0);
+            pop_scene(app);
+            break;
+        case 1:
+            printf("Starting a New Game\n");
+            Mix_PlayChannel(-1, menu_sound, 0);
+            reset_board(app->board);
+            enter_game(app);
+            break;
+        case 2:
+            printf("Exiting Game\n");
+            app->depth = 0;
+            break;
+        default:
+            break;
+    }
+}
 
-    bool running = true;
-    SDL_Event event;
+static void promotion_event(App* app, const SDL_Event* event) {
+    update_buttons(app->promotionButtons, 2, event);
+    int choice = clicked_button(app->promotionButtons, 2, event);
+    if (choice < 0) {
+        return;
+    }
+    // The pawn already stands on the last row; its case gives the colour
+    char* square = &app->board[app->promotionRow][app->promotionCol];
+    char piece = choice == 0 ? 'q' : 'n';
+    *square = islower((unsigned char)*square) ? piece : toupper((unsigned char)piece);
+    printf("Pawn promoted to %s\n", choice == 0 ? "Queen" : "Knight");
+    Mix_PlayChannel(-1, menu_sound, 0);
+    pop_scene(app);
+    finish_move(app);
+}
 
-    while (running) {
-        while (SDL_PollEvent(&event)) {
-            if (event.type == SDL_QUIT) {
-                running = false;
-            } else if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT) {
-                int mouseX, mouseY;
-                SDL_GetMouseState(&mouseX, &mouseY);
-
-                if (handle_button_click(&resumeButton, mouseX, mouseY)) {
-                    printf("Resuming Game\n");
-                    Mix_PlayChannel(-1, menu_sound, 0);
-                    game_event(renderer, font, popUp_font, textures, board, window);                  
-                    running = false;
-
-                } else if (handle_button_click(&newGameButton, mouseX, mouseY)) {
-                    printf("Starting a New Game\n");
-                    Mix_PlayChannel(-1, menu_sound, 0);
-                    reset_board(board);
-                    game_event(renderer, font, popUp_font, textures, board, window);
-                    running = false;
-                } else if (handle_button_click(&exitButton, mouseX, mouseY)) {
-                    printf("Exiting Game\n");
-                    exit(0);
-                }
-            }
+static void game_over_event(App* app, const SDL_Event* event) {
+    update_buttons(app->gameOverButtons, 2, event);
+    switch (clicked_button(app->gameOverButtons, 2, event)) {
+        case 0:
+            Mix_PlayChannel(-1, menu_sound, 0);
+            reset_board(app->board);
+            enter_game(app);
+            break;
+        case 1:
+            app->depth = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+static void game_key_event(App* app, const SDL_Event* event) {
+    char (*board)[8] = app->board;
+    SDL_Keycode key = event->key.keysym.sym;
+    if (key == SDLK_ESCAPE) {
+        // Handle showing the popup menu
+        push_scene(app, SCENE_PAUSE);
+    } else if (key == SDLK_a) {
+        // Toggle the analysis panel
+        analysisEnabled = !analysisEnabled;
+        if (analysisEnabled) {
+            analysis_start(&analysis, board, turn, analysisLines);
+        } else {
+            analysis_stop(&analysis);
+        }
+        scheduler_invalidate(&scheduler);
+    } else if (key == SDLK_s) {
+        // Toggle the search statistics
+        statsEnabled = !statsEnabled;
+        scheduler_invalidate(&scheduler);
+    } else if (key == SDLK_m) {
+        // Find mate for the side to move
+        start_mate_search(board);
+        scheduler_invalidate(&scheduler);
+    } else if (key == SDLK_b) {
+        // Let the opening book move for the side to move
+        Move move;
+        if (play_book_move(board, &move)) {
+            start_move_animation(app, move);
+            Mix_PlayChannel(-1, move_sound, 0);
+            app->selectedRow = -1;
+            app->selectedCol = -1;
+            app->selectedPiece = ' ';
+            finish_move(app);
+        } else {
+            Mix_PlayChannel(-1, invalid_sound, 0);
+        }
+    } else if (key >= SDLK_1 && key <= SDLK_5) {
+        // Number of candidate lines to keep
+        analysisLines = key - SDLK_0;
+        if (analysisEnabled) {
+            analysis_start(&analysis, board, turn, analysisLines);
+        }
+    }
+}
+
+static void game_mouse_event(App* app, const SDL_Event* event) {
+    if (event->button.button != SDL_BUTTON_LEFT) {
+        return;
+    }
+    char (*board)[8] = app->board;
+
+    // Calculate the clicked tile's row and column; the margin around the
+    // board is no square
+    int x = event->button.x - layout.board.x;
+    int y = event->button.y - layout.board.y;
+    if (x < 0 || y < 0 || x >= layout.board.w || y >= layout.board.h) {
+        return;
+    }
+    int clickedCol = x / layout.squareW;
+    int clickedRow = y / layout.squareH;
+
+    // Handle the piece selection and movement
+    if (app->selectedRow == -1 && app->selectedCol == -1) {
+        // Selecting a piece
+        if ((turn == WHITE && isupper(board[clickedRow][clickedCol])) ||
+            (turn == BLACK && islower(board[clickedRow][clickedCol]))) {
+            app->selectedRow = clickedRow;
+            app->selectedCol = clickedCol;
+            app->selectedPiece = board[clickedRow][clickedCol];
+            Mix_PlayChannel(-1, move_sound, 0);
         }
+        return;
+    }
 
-        draw_button(renderer, popUp_font, &resumeButton);
-        draw_button(renderer, popUp_font, &newGameButton);
-        draw_button(renderer, popUp_font, &exitButton);
+    // Attempting to move the selected piece
+    bool promoted = false;
+    if (!validate_move(board, app->selectedRow, app->selectedCol, clickedRow, clickedCol, &promoted)) {
+        // If the move is invalid, reset the selection
+        app->selectedRow = -1;
+        app->selectedCol = -1;
+        app->selectedPiece = ' ';
+        Mix_PlayChannel(-1, invalid_sound, 0);
+        return;
+    }
 
-        SDL_RenderPresent(renderer);
+    // Move the piece if the move is valid
+    Move move = {
+        (unsigned char)SQUARE(app->selectedRow, app->selectedCol), (unsigned char)SQUARE(clickedRow, clickedCol),
+        app->selectedPiece, board[clickedRow][clickedCol], ' '
+    };
+    start_move_animation(app, move);
+    board[clickedRow][clickedCol] = app->selectedPiece;
+    board[app->selectedRow][app->selectedCol] = ' ';
+    Mix_PlayChannel(-1, move_sound, 0);
+    app->selectedRow = -1;
+    app->selectedCol = -1;
+    app->selectedPiece = ' ';
+
+    // Switch turns
+    turn = (turn == WHITE) ? BLACK : WHITE;
+
+    // A pawn on the last row waits for its piece before the move completes
+    if (promoted) {
+        printf("Pawn reaches to the end\n");
+        Mix_PlayChannel(-1, promote_sound, 0);
+        app->promotionRow = clickedRow;
+        app->promotionCol = clickedCol;
+        push_scene(app, SCENE_PROMOTION);
+        return;
     }
+    finish_move(app);
 }
 
-void show_promotion_menu(SDL_Renderer* renderer, TTF_Font* font, TTF_Font* popUp_font, SDL_Texture** textures, char board[8][8], SDL_Window* window, int clickedRow, int clickedCol, int selectedRow, int selectedCol) {
-    SDL_Color backgroundColor = {0, 0, 0, 255};
-    SDL_SetRenderDrawColor(renderer, backgroundColor.r, backgroundColor.g, backgroundColor.b, backgroundColor.a);
-    SDL_RenderClear(renderer);
+static void game_scene_event(App* app, const SDL_Event* event) {
+    if (event->type == SDL_KEYDOWN) {
+        game_key_event(app, event);
+    } else if (event->type == SDL_MOUSEBUTTONDOWN) {
+        game_mouse_event(app, event);
+    }
+}
 
-    SDL_Color textColor = {255, 255, 255}; // White color for text
+// Work finished on other threads since the last pass: analysis lines, the
+// mate search and the statistics refresh
+static void poll_game(App* app) {
+    if (analysisEnabled) {
+        analysis_snapshot(&analysis, &app->snapshot);
+        if (app->snapshot.generation != app->shownGeneration) {
+            scheduler_invalidate(&scheduler);
+        }
+    }
+    if (statsEnabled && analysis_running(&analysis) && SDL_GetTicks() - app->statsShown >= STATS_REFRESH_MS) {
+        scheduler_invalidate(&scheduler);
+    }
+    if (mateThread && SDL_AtomicGet(&mateDone)) {
+        SDL_WaitThread(mateThread, NULL);
+        mateThread = NULL;
+        mate_format_line(&matePosition, &mateResult, mateText, sizeof(mateText));
+        printf("%s\n", mateText);
+        scheduler_invalidate(&scheduler);
+    }
+}
 
-    Button queenButton = {{WINDOW_WIDTH / 2 - 150, WINDOW_HEIGHT / 2 - 100, 100, 30}, "Promote To Queen", false};
-    Button knightButton = {{WINDOW_WIDTH / 2 - 150, WINDOW_HEIGHT / 2, 100, 30}, "Promote To Knight", false};
-    
+// How long the game may sleep without input: until the next statistics
+// refresh while they are shown over a running search, otherwise forever
+static int game_idle_timeout(const App* app) {
+    if (!statsEnabled || !analysis_running(&analysis)) {
+        return -1;
+    }
+    Uint32 since = SDL_GetTicks() - app->statsShown;
+    return since >= STATS_REFRESH_MS ? 0 : (int)(STATS_REFRESH_MS - since);
+}
 
-    bool running = true;
-    SDL_Event event;
+// Drops a scale's fonts and pieces, with the glyph atlases made from them
+static void free_scaled_assets(ScaledAssets* assets) {
+    text_forget_font(assets->font);
+    text_forget_font(assets->menuFont);
+    resource_release(assets->font);
+    resource_release(assets->menuFont);
+    pieces_free(&assets->pieces);
+    memset(assets, 0, sizeof(*assets));
+}
 
-    while (running) {
-        while (SDL_PollEvent(&event)) {
-            if (event.type == SDL_QUIT) {
-                running = false;
-            } else if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT) {
-                int mouseX, mouseY;
-                SDL_GetMouseState(&mouseX, &mouseY);
-
-                if (handle_button_click(&queenButton, mouseX, mouseY)) {
-                    printf("Pawn promoted to Queen\n");
-                    printf("Selected Row: %d, Selected Col: %d\n", selectedRow, selectedCol);
-                    Mix_PlayChannel(-1, menu_sound, 0);
-                    // Check the color of the pawn and promote accordingly
-                    if (board[selectedRow][selectedCol] == 'p') {
-                        board[clickedRow][clickedCol] = 'q'; // Black pawn promoted to queen
-                    } else if (board[selectedRow][selectedCol] == 'P') {
-                        board[clickedRow][clickedCol] = 'Q'; // White pawn promoted to queen
-                    }
-                    printf("Promoted piece: %c\n", board[clickedRow][clickedCol]);
-                    running = false;
-
-
-                } else if (handle_button_click(&knightButton, mouseX, mouseY)) {
-                    printf("Pawn promoted to Knight\n");
-                    printf("Selected Row: %d, Selected Col: %d\n", selectedRow, selectedCol);
-                    Mix_PlayChannel(-1, menu_sound, 0);
-                    // Check the color of the pawn and promote accordingly
-                    if (board[selectedRow][selectedCol] == 'p') {
-                        board[clickedRow][clickedCol] = 'n'; // Black pawn promoted to knight
-                    } else if (board[selectedRow][selectedCol] == 'P') {
-                        board[clickedRow][clickedCol] = 'N'; // White pawn promoted to knight
-                    }
-
-                    printf("Promoted piece: %c\n", board[clickedRow][clickedCol]);
-                    running = false;
-                } 
-                
-            }
+// The fonts and pieces for a scale, from the cache or loaded into the slot
+// used longest ago. NULL when the fonts cannot be opened.
+static ScaledAssets* scaled_assets(SDL_Renderer* renderer, int steps) {
+    ScaledAssets* slot = &scaledAssets[0];
+    for (int i = 0; i < MAX_CACHED_SCALES; i++) {
+        if (scaledAssets[i].scaleSteps == steps) {
+            scaledAssets[i].lastUsed = ++scaledAssetsClock;
+            return &scaledAssets[i];
+        }
+        if (scaledAssets[i].lastUsed < slot->lastUsed) {
+            slot = &scaledAssets[i];
         }
+    }
 
-        draw_button(renderer, popUp_font, &queenButton);
-        draw_button(renderer, popUp_font, &knightButton);
-        
+    free_scaled_assets(slot);
+    slot->font = resource_font(FONT_FILE, SDL_max(GAME_FONT_SIZE * steps / LAYOUT_STEPS, 1));
+    slot->menuFont = resource_font(FONT_FILE, SDL_max(MENU_FONT_SIZE * steps / LAYOUT_STEPS, 1));
+    if (!slot->font || !slot->menuFont) {
+        printf("Failed to load font: %s\n", TTF_GetError());
+        free_scaled_assets(slot);
+        return NULL;
+    }
+    Layout sizes;
+    layout_sizes(&sizes, steps);
+    pieces_load(&slot->pieces, renderer, sizes.pieceW, sizes.pieceH);
+    slot->scaleSteps = steps;
+    slot->lastUsed = ++scaledAssetsClock;
+    return slot;
+}
 
-        SDL_RenderPresent(renderer);
+// Moves buttons to their place at the current scale. The labels are kept
+// unless the scale changed, then they render again at the new font size on
+// the next draw.
+static void place_buttons(Button* buttons, int count, bool rescaled) {
+    for (int i = 0; i < count; i++) {
+        if (rescaled) {
+            free_button(&buttons[i]);
+        }
+        buttons[i].rect.x = layout.board.x + scaled(buttons[i].origin.x);
+        buttons[i].rect.y = layout.board.y + scaled(buttons[i].origin.y);
     }
 }
 
-void game_event(SDL_Renderer* renderer, TTF_Font* font, TTF_Font* popUp_font, SDL_Texture** textures, char board[8][8], SDL_Window* window){
+// Lays the screen out again when the output size changed, after a resize or
+// a move to a display with another pixel density. The assets of the new
+// scale load the first time it is used. Returns false when there are no
+// fonts to draw with.
+static bool update_layout(App* app) {
+    int outputW, outputH, windowW, windowH;
+    if (SDL_GetRendererOutputSize(app->renderer, &outputW, &outputH) != 0) {
+        return app->font != NULL;
+    }
+    if (outputW == layout.outputW && outputH == layout.outputH && app->font) {
+        return true;
+    }
+    SDL_GetWindowSize(app->window, &windowW, &windowH);
+    layout.outputW = outputW;
+    layout.outputH = outputH;
+    layout.pixelRatio = windowW > 0 ? (float)outputW / windowW : 1.0f;
+
+    int steps = SDL_min(outputW * LAYOUT_STEPS / BASE_WIDTH, outputH * LAYOUT_STEPS / BASE_HEIGHT);
+    steps = SDL_max(steps, 1);
+    if (steps != layout.scaleSteps || !app->font) {
+        ScaledAssets* assets = scaled_assets(app->renderer, steps);
+        if (assets) {
+            app->font = assets->font;
+            app->menuFont = assets->menuFont;
+            app->pieces = &assets->pieces;
+        } else if (app->font) {
+            // Stay at the scale that has its fonts
+            steps = layout.scaleSteps;
+        } else {
+            return false;
+        }
+    }
 
-            int running = 1;
-            // Draw the chess board and render chess pieces
+    bool rescaled = steps != layout.scaleSteps;
+    layout_sizes(&layout, steps);
+    layout.board.w = BOARD_SIZE * layout.squareW;
+    layout.board.h = BOARD_SIZE * layout.squareH;
+    layout.board.x = (outputW - layout.board.w) / 2;
+    layout.board.y = (outputH - layout.board.h) / 2;
+    place_buttons(app->menuButtons, 2, rescaled);
+    place_buttons(app->pauseButtons, 3, rescaled);
+    place_buttons(app->promotionButtons, 2, rescaled);
+    place_buttons(app->gameOverButtons, 2, rescaled);
+    scheduler_invalidate(&scheduler);
+    return true;
+}
 
-            draw_board(renderer, font);
-            render_chess_pieces(renderer, textures, board);
-            
-            // Initialize the selected piece variables
-            int selectedRow = -1;
-            int selectedCol = -1;
-            char selectedPiece = ' ';
-            bool showingMenu = false;
-            bool promoted = false; //
-
-            // Initialization
-            SDL_Renderer* offscreen_renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-            SDL_SetRenderDrawBlendMode(offscreen_renderer, SDL_BLENDMODE_BLEND);
-
-            SDL_Event event;
-
-            // Event loop
-            while (running) {
-                while (SDL_PollEvent(&event)) {
-                    switch (event.type) {
-
-                       case SDL_QUIT:
-                            // Check if the event was triggered by the close button
-                            if (!showingMenu && event.window.event == SDL_WINDOWEVENT_CLOSE) {
-                                running = 0;
-                            }
-                            break;
-                        case SDL_KEYDOWN:
-                            if (!showingMenu && event.key.keysym.sym == SDLK_ESCAPE) {
-                                // Handle showing the popup menu
-                                show_popup_menu(renderer, font, popUp_font, textures, board, window);
-                                showingMenu = true;
-                            }
-                            break;
-
-                        case SDL_MOUSEBUTTONDOWN:
-                            if (event.button.button == SDL_BUTTON_LEFT) {
-                                // Get the mouse position
-                                int mouseX = event.button.x;
-                                int mouseY = event.button.y;
-
-                                // Calculate the clicked tile's row and column
-                                int clickedCol = mouseX / (WINDOW_WIDTH / BOARD_SIZE);
-                                int clickedRow = mouseY / (WINDOW_HEIGHT / BOARD_SIZE);
-
-                                // Handle the piece selection and movement
-                                if (selectedRow == -1 && selectedCol == -1) {
-                                    // Selecting a piece
-                                    if ((turn == WHITE && isupper(board[clickedRow][clickedCol])) ||
-                                        (turn == BLACK && islower(board[clickedRow][clickedCol]))) {
-                                        selectedRow = clickedRow;
-                                        selectedCol = clickedCol;
-                                        selectedPiece = board[selectedRow][selectedCol];
-                                        Mix_PlayChannel(-1, move_sound, 0);
-                                        
-                                    }
-                                } else {
-                                    // Attempting to move the selected piece
-                                    if (validate_move(board, selectedRow, selectedCol, clickedRow, clickedCol, &promoted)) {
-                                        // Move the piece if the move is valid
-                                        board[clickedRow][clickedCol] = selectedPiece;
-                                        board[selectedRow][selectedCol] = ' ';
-                                        Mix_PlayChannel(-1, move_sound, 0);
- 
-                                        // Reset the selection
-                                        selectedRow = -1;
-                                        selectedCol = -1;
-                                        selectedPiece = ' ';
-                                        
-                                        
-                                        // Switch turns
-                                        turn = (turn == WHITE) ? BLACK : WHITE;
-
-                                        // Check if the pawn has been promoted
-                                        if (promoted) {
-                                            selectedRow = clickedRow;
-                                            selectedCol = clickedCol;
-                                            Mix_PlayChannel(-1, promote_sound, 0);
-                                            show_promotion_menu(renderer, font, popUp_font, textures, board, window, clickedRow, clickedCol, selectedRow, selectedCol);
-                                            printf("Pawn reaches to the end\n");
-                                            promoted = false;
-                                        }
-                                        
-                                        // Redraw the board and pieces
-                                        draw_board(renderer, font);
-                                        render_chess_pieces(renderer, textures, board);
-                                        printf("Current player's turn: %c\n", turn);
-                                    } else {
-                                        // If the move is invalid, reset the selection
-                                        selectedRow = -1;
-                                        selectedCol = -1;
-                                        selectedPiece = ' ';
-                                        Mix_PlayChannel(-1, invalid_sound, 0);
-                                    }
-                                }
-                            }
-                            break;
-
-                        
-                        default:
-                            break;
-                    }
-                }
+// Mouse positions come in window coordinates, the layout is in output
+// pixels; the two differ on a HiDPI display
+static void scale_mouse_event(SDL_Event* event) {
+    if (event->type == SDL_MOUSEMOTION) {
+        event->motion.x = (int)(event->motion.x * layout.pixelRatio);
+        event->motion.y = (int)(event->motion.y * layout.pixelRatio);
+    } else if (event->type == SDL_MOUSEBUTTONDOWN || event->type == SDL_MOUSEBUTTONUP) {
+        event->button.x = (int)(event->button.x * layout.pixelRatio);
+        event->button.y = (int)(event->button.y * layout.pixelRatio);
+    }
+}
 
+static void draw_scene(App* app, Scene scene) {
+    SDL_Renderer* renderer = app->renderer;
+    // Black around the board when the window is not the layout's shape
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+    if (scene == SCENE_GAME || scene == SCENE_GAME_OVER) {
+        redraw_game(app);
+        app->shownGeneration = app->snapshot.generation;
+        app->statsShown = SDL_GetTicks();
+    } else if (scene == SCENE_PAUSE || scene == SCENE_PROMOTION) {
+        // The game stays visible, dimmed, under the menu
+        redraw_game(app);
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 160);
+        SDL_RenderFillRect(renderer, &layout.board);
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    }
+
+    switch (scene) {
+        case SCENE_MENU:
+            draw_buttons(renderer, app->menuFont, app->menuButtons, 2);
+            break;
+        case SCENE_PAUSE:
+            draw_buttons(renderer, app->menuFont, app->pauseButtons, 3);
+            break;
+        case SCENE_PROMOTION:
+            draw_buttons(renderer, app->menuFont, app->promotionButtons, 2);
+            break;
+        case SCENE_GAME_OVER: {
+            // Dim the final position under the result
+            SDL_Rect panel = {layout.board.x + scaled(BASE_WIDTH / 2 - 200), layout.board.y + scaled(BASE_HEIGHT / 2 - 130),
+                              scaled(400), scaled(240)};
+            SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 200);
+            SDL_RenderFillRect(renderer, &panel);
+            SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+            SDL_Color white = {255, 255, 255, 255};
+            int width = text_width(renderer, app->menuFont, app->resultText);
+            text_draw(renderer, app->menuFont, app->resultText, panel.x + panel.w / 2 - width / 2, panel.y + scaled(20), white);
+            draw_buttons(renderer, app->menuFont, app->gameOverButtons, 2);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Sets up the buttons of every scene and lays them out for the window's
+// size; the labels render on first draw. Fails when the fonts do not load.
+bool init_scenes(App* app) {
+    Button menu[2] = {
+        {.rect = {BASE_WIDTH / 2 - 110, BASE_HEIGHT / 2 - 100, 100, 30}, .text = "Start Game"},
+        {.rect = {BASE_WIDTH / 2 - 95, BASE_HEIGHT / 2 - 25, 100, 30}, .text = "Exit Game"}
+    };
+    Button pause[3] = {
+        {.rect = {BASE_WIDTH / 2 - 75, BASE_HEIGHT / 2 - 100, 100, 30}, .text = "Resume"},
+        {.rect = {BASE_WIDTH / 2 - 75, BASE_HEIGHT / 2 - 50, 100, 30}, .text = "New Game"},
+        {.rect = {BASE_WIDTH / 2 - 75, BASE_HEIGHT / 2, 100, 30}, .text = "Exit"}
+    };
+    Button promotion[2] = {
+        {.rect = {BASE_WIDTH / 2 - 150, BASE_HEIGHT / 2 - 100, 100, 30}, .text = "Promote To Queen"},
+        {.rect = {BASE_WIDTH / 2 - 150, BASE_HEIGHT / 2, 100, 30}, .text = "Promote To Knight"}
+    };
+    Button gameOver[2] = {
+        {.rect = {BASE_WIDTH / 2 - 75, BASE_HEIGHT / 2 - 30, 100, 30}, .text = "New Game"},
+        {.rect = {BASE_WIDTH / 2 - 75, BASE_HEIGHT / 2 + 20, 100, 30}, .text = "Exit"}
+    };
+    memcpy(app->menuButtons, menu, sizeof(menu));
+    memcpy(app->pauseButtons, pause, sizeof(pause));
+    memcpy(app->promotionButtons, promotion, sizeof(promotion));
+    memcpy(app->gameOverButtons, gameOver, sizeof(gameOver));
+    Button* all[] = {app->menuButtons, app->pauseButtons, app->promotionButtons, app->gameOverButtons};
+    int counts[] = {2, 3, 2, 2};
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < counts[i]; j++) {
+            all[i][j].origin.x = all[i][j].rect.x;
+            all[i][j].origin.y = all[i][j].rect.y;
+        }
+    }
+    app->depth = 0;
+    app->shownGeneration = -1;
+    return update_layout(app);
+}
 
-                SDL_Delay(100); // Adjust this delay as needed;
+// The one loop of the game. Each pass hands the waiting events to the scene
+// on top of the stack and draws that scene when something changed, so
+// opening the menu any number of times never nests a call.
+void run_scenes(App* app) {
+    scheduler_init(&scheduler, app->window);
+    analysis.onUpdate = scheduler_wake;
+    push_scene(app, SCENE_MENU);
+
+    while (app->depth > 0) {
+        int idleTimeout = current_scene(app) == SCENE_GAME ? game_idle_timeout(app) : -1;
+        SDL_Event event;
+        while (app->depth > 0 && scheduler_next_event(&scheduler, &event, idleTimeout)) {
+            if (event.type == SDL_QUIT) {
+                app->depth = 0;
+                break;
+            }
+            // Some backends lose what was drawn into target textures; a lost
+            // device takes every texture with it, so those load again
+            if (event.type == SDL_RENDER_TARGETS_RESET) {
+                app->boardCache.valid = false;
+                scheduler_invalidate(&scheduler);
+            } else if (event.type == SDL_RENDER_DEVICE_RESET) {
+                free_scenes(app);
+                text_free();
+                update_layout(app);
+            }
+            if (event.type == SDL_WINDOWEVENT) {
+                update_layout(app);
             }
+            scale_mouse_event(&event);
+            switch (current_scene(app)) {
+                case SCENE_MENU:
+                    menu_event(app, &event);
+                    break;
+                case SCENE_GAME:
+                    game_scene_event(app, &event);
+                    break;
+                case SCENE_PAUSE:
+                    pause_event(app, &event);
+                    break;
+                case SCENE_PROMOTION:
+                    promotion_event(app, &event);
+                    break;
+                case SCENE_GAME_OVER:
+                    game_over_event(app, &event);
+                    break;
+            }
+        }
+        if (app->depth == 0) {
+            break;
+        }
+
+        if (current_scene(app) == SCENE_GAME) {
+            poll_game(app);
+        }
+        tick_move_animation(app, current_scene(app));
+        if (scheduler_frame_due(&scheduler)) {
+            update_layout(app);
+            draw_scene(app, current_scene(app));
+            SDL_RenderPresent(app->renderer);
+            scheduler_frame_done(&scheduler);
+        }
+    }
+
+    analysis_stop(&analysis);
+    stop_mate_search();
+}
 
-}
\ No newline at end of file
+void free_scenes(App* app) {
+    free_board_cache(&app->boardCache);
+    for (int i = 0; i < MAX_CACHED_SCALES; i++) {
+        free_scaled_assets(&scaledAssets[i]);
+    }
+    app->font = NULL;
+    app->menuFont = NULL;
+    app->pieces = NULL;
+    memset(&layout, 0, sizeof(layout));
+    for (int i = 0; i < 2; i++) {
+        free_button(&app->menuButtons[i]);
+        free_button(&app->promotionButtons[i]);
+        free_button(&app->gameOverButtons[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        free_button(&app->pauseButtons[i]);
+    }
+}
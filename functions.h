@@ -7,11 +7,29 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <SDL2/SDL_ttf.h>
+#include "analysis.h"
+#include "pieces.h"
+
+// Looks a button has, each with its own label texture
+enum {
+    BUTTON_NORMAL,
+    BUTTON_HOVER,
+    BUTTON_PRESSED,
+    BUTTON_STATES
+};
 
 typedef struct {
     SDL_Rect rect;
     char* text;
     bool clicked;
+    bool hover;             // mouse over the button
+    bool pressed;           // mouse button held down on it
+    // Labels for every look, rendered on the first draw and again only
+    // after the text or the font changes
+    SDL_Texture* labels[BUTTON_STATES];
+    TTF_Font* labelFont;
+    char labelText[64];
+    SDL_Point origin;       // position in the base layout
 } Button;
 
 typedef struct {
@@ -19,12 +37,112 @@ typedef struct {
     char text[100]; // Adjust the size according to your needs
 } TextInputField;
 
+// Screens of the game. They sit on a stack and only the top one gets input
+// and is drawn; the pause and promotion menus push over the game and pop
+// back to it.
+typedef enum {
+    SCENE_MENU,
+    SCENE_GAME,
+    SCENE_PAUSE,
+    SCENE_PROMOTION,
+    SCENE_GAME_OVER
+} Scene;
+
+#define MAX_SCENES 8
+
+// A move on its way: the piece slides from move.from to move.to while the
+// piece it captured fades out
+typedef struct {
+    bool active;
+    Move move;
+    Uint64 start;           // performance counter when it began
+} MoveAnimation;
+
+// The layout is designed at BASE_WIDTH x BASE_HEIGHT. Any other window
+// draws it at the largest scale, in steps of 1/LAYOUT_STEPS, that fits the
+// renderer's output in pixels, centred; on a HiDPI display that is more
+// pixels than the window has points.
+#define BASE_WIDTH 800
+#define BASE_HEIGHT 640
+#define LAYOUT_STEPS 8
+
+#define FONT_FILE "Atop-R99O3.ttf"
+#define GAME_FONT_SIZE 15       // at the base scale
+#define MENU_FONT_SIZE 32
+
+typedef struct {
+    int outputW, outputH;   // renderer output in pixels
+    float pixelRatio;       // output pixels per window coordinate
+    int scaleSteps;         // LAYOUT_STEPS is the base size
+    SDL_Rect board;         // in output pixels
+    int squareW, squareH;
+    int pieceW, pieceH;
+} Layout;
+
+// Fonts and pieces built for one scale. The last few scales used are kept,
+// so resizing back and forth reuses them instead of loading again.
+#define MAX_CACHED_SCALES 4
+
+typedef struct {
+    int scaleSteps;         // 0 for an empty slot
+    TTF_Font* font;
+    TTF_Font* menuFont;
+    PieceAtlas pieces;
+    Uint32 lastUsed;
+} ScaledAssets;
+
+// The board's squares and pieces drawn once into a target texture; later
+// updates redraw only the squares that differ from shown
+typedef struct {
+    SDL_Texture* texture;
+    char shown[8][8];
+    int w, h;
+    bool valid;             // false until every square has been drawn
+    bool unsupported;       // no target textures, draw directly
+} BoardCache;
+
+// Everything the scenes share, owned by main
+typedef struct {
+    SDL_Window* window;
+    SDL_Renderer* renderer;
+    // Assets of the current scale, see update_layout
+    TTF_Font* font;         // game text
+    TTF_Font* menuFont;     // buttons and the result
+    const PieceAtlas* pieces;
+    char (*board)[8];
+    BoardCache boardCache;
+    MoveAnimation animation;
+
+    Scene stack[MAX_SCENES];
+    int depth;
+
+    Button menuButtons[2];
+    Button pauseButtons[3];
+    Button promotionButtons[2];
+    Button gameOverButtons[2];
+
+    int selectedRow;        // -1 while no piece is selected
+    int selectedCol;
+    char selectedPiece;
+    int promotionRow;       // pawn waiting for its piece
+    int promotionCol;
+    char resultText[64];
+
+    AnalysisSnapshot snapshot;
+    int shownGeneration;    // snapshot generation on screen
+    Uint32 statsShown;      // ticks of the last statistics redraw
+} App;
+
 SDL_Window* create_window(const char* title, int width, int height);
 void load_sounds();
+void free_sounds(void);
+void load_opening_book(const char* path);
+void free_opening_book(void);
 void render_text(SDL_Renderer* renderer, TTF_Font* font, const char* text, int x, int y);
 void draw_board(SDL_Renderer* renderer, TTF_Font* font);
-void load_chess_pieces(SDL_Renderer* renderer, SDL_Texture** textures);
-void render_chess_pieces(SDL_Renderer* renderer, SDL_Texture** textures, char board[8][8]);
+void render_chess_pieces(SDL_Renderer* renderer, const PieceAtlas* pieces, char board[8][8]);
+void draw_analysis_panel(SDL_Renderer* renderer, TTF_Font* font, const AnalysisSnapshot* snapshot);
+void draw_stats_overlay(SDL_Renderer* renderer, TTF_Font* font, const SearchStats* stats);
 void promote_pawn(char board[8][8], int row, int col, char promotionPiece);
 bool validate_pawn_move(char board[8][8], int fromRow, int fromCol, int toRow, int toCol, bool *promoted);
 bool validate_rook_move(char board[8][8], int fromRow, int fromCol, int toRow, int toCol);
@@ -35,14 +153,15 @@ bool validate_king_move(char board[8][8], int fromRow, int fromCol, int toRow, i
 bool validate_move(char board[8][8], int fromRow, int fromCol, int toRow, int toCol, bool* promoted);
 void draw_button(SDL_Renderer* renderer, TTF_Font* font, Button* button);
 bool handle_button_click(Button* button, int mouseX, int mouseY);
+bool update_button_state(Button* button, const SDL_Event* event);
+void free_button(Button* button);
 void reset_board(char board[8][8]);
 void draw_text_input_field(SDL_Renderer* renderer, TTF_Font* font, TextInputField* inputField);
 bool handle_text_input_event(SDL_Event* event, TextInputField* inputField);
 void save_game(const char* filename, char board[8][8], char turn);
 void load_game(const char* filename, char board[8][8], char* turn);
-bool menu_screen(TTF_Font* font, SDL_Renderer* renderer);
-void show_popup_menu(SDL_Renderer* renderer, TTF_Font* font, TTF_Font* popUp_font, SDL_Texture** textures, char board[8][8], SDL_Window* window);
-void show_promotion_menu(SDL_Renderer* renderer, TTF_Font* font, TTF_Font* popUp_font, SDL_Texture** textures, char board[8][8], SDL_Window* window, int clickedRow, int clickedCol, int selectedRow, int selectedCol);
-void game_event(SDL_Renderer* renderer, TTF_Font* font, TTF_Font* popUp_font, SDL_Texture** textures, char board[8][8], SDL_Window* window);
+bool init_scenes(App* app);
+void run_scenes(App* app);
+void free_scenes(App* app);
 
 #endif
\ No newline at end of file
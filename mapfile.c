@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "mapfile.h"
+
+bool map_file(MappedFile* file, const char* path, bool randomAccess) {
+    memset(file, 0, sizeof(*file));
+#ifdef _WIN32
+    DWORD flags = randomAccess ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN;
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    file->file = handle;
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(handle, &size) && size.QuadPart > 0 && (uint64_t)size.QuadPart <= SIZE_MAX) {
+        file->size = (size_t)size.QuadPart;
+        file->mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    if (file->mapping) {
+        file->data = MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, st.st_size, randomAccess ? MADV_RANDOM : MADV_NORMAL);
+            file->data = data;
+            file->size = st.st_size;
+        }
+    }
+    close(fd);
+#endif
+    if (!file->data) {
+        printf("Error mapping %s\n", path);
+        unmap_file(file);
+        return false;
+    }
+    return true;
+}
+
+void unmap_file(MappedFile* file) {
+#ifdef _WIN32
+    if (file->data) {
+        UnmapViewOfFile(file->data);
+    }
+    if (file->mapping) {
+        CloseHandle(file->mapping);
+    }
+    if (file->file) {
+        CloseHandle(file->file);
+    }
+#else
+    if (file->data) {
+        munmap((void*)file->data, file->size);
+    }
+#endif
+    memset(file, 0, sizeof(*file));
+}
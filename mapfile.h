@@ -0,0 +1,24 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A whole file mapped read-only and shared. Opening costs the same for any
+// file size, pages are read on first touch, and every process mapping the
+// same file shares one copy in the page cache. On a 32-bit build a file has
+// to fit in the address space.
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    void* file;             // Windows file and mapping handles
+    void* mapping;
+} MappedFile;
+
+// False without a message when the file does not exist. randomAccess turns
+// off read-ahead for files that are probed at scattered offsets.
+bool map_file(MappedFile* file, const char* path, bool randomAccess);
+void unmap_file(MappedFile* file);
+
+#endif
@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mate.h"
+
+// Depth-first proof-number search (df-pn). The side to move at the root is
+// the attacker. Every node keeps a proof number, the number of leaves that
+// still have to be proved for the attacker to mate, and a disproof number,
+// the leaves that have to hold for the defender to escape. In the negamax
+// form below phi is the number for the side to move and delta the one for
+// the other side, so OR and AND nodes share one routine.
+//
+// The search is bounded by a number of plies. Proving mate in 1, 2, 3 ...
+// moves in turn makes the first proof the shortest mate, and the table keeps
+// proofs and disproofs from one bound to the next.
+
+#define PN_INFINITE 0x3FFFFFFF
+#define MATE_TABLE_BITS 20
+
+typedef struct {
+    uint64_t key;
+    uint32_t pn;
+    uint32_t dn;
+    int depth;              // plies left when the numbers were stored
+} MateEntry;
+
+typedef struct {
+    Position pos;
+    int attacker;
+    MateEntry* table;
+    uint64_t nodes;
+    uint64_t nodeLimit;
+    SDL_atomic_t* stopSignal;
+    bool aborted;
+    uint64_t repetitions;   // repetition cutoffs so far
+} MateSearch;
+
+static uint32_t add_numbers(uint32_t a, uint32_t b) {
+    return (a + (uint64_t)b >= PN_INFINITE) ? PN_INFINITE : a + b;
+}
+
+// A proof with fewer plies holds for more; a disproof with more plies holds
+// for fewer. Unresolved numbers are only reused at the same bound.
+static void probe(const MateSearch* ms, uint64_t key, int depth, uint32_t* pn, uint32_t* dn) {
+    const MateEntry* entry = &ms->table[key & ((1 << MATE_TABLE_BITS) - 1)];
+    if (entry->key == key) {
+        if (entry->pn == 0 && entry->depth <= depth) {
+            *pn = 0;
+            *dn = PN_INFINITE;
+            return;
+        }
+        if (entry->dn == 0 && entry->depth >= depth) {
+            *pn = PN_INFINITE;
+            *dn = 0;
+            return;
+        }
+        if (entry->depth == depth) {
+            *pn = entry->pn;
+            *dn = entry->dn;
+            return;
+        }
+    }
+    *pn = 1;
+    *dn = 1;
+}
+
+static void store(MateSearch* ms, uint64_t key, int depth, uint32_t pn, uint32_t dn) {
+    MateEntry* entry = &ms->table[key & ((1 << MATE_TABLE_BITS) - 1)];
+    // A proof holds for every longer bound, so it is only replaced by a proof
+    // of the same position in fewer plies
+    if (entry->key == key && entry->pn == 0 && (pn != 0 || depth >= entry->depth)) {
+        return;
+    }
+    entry->key = key;
+    entry->pn = pn;
+    entry->dn = dn;
+    entry->depth = depth;
+}
+
+// Proof and disproof numbers of a position that needs no search, or false
+static bool terminal(MateSearch* ms, const MoveList* list, int depth, uint32_t* pn, uint32_t* dn) {
+    Position* pos = &ms->pos;
+    bool attackerToMove = pos->side == ms->attacker;
+    if (list->count == 0) {
+        // Mate by the attacker proves the node; any other end disproves it
+        bool mated = in_check(pos) && !attackerToMove;
+        *pn = mated ? 0 : PN_INFINITE;
+        *dn = mated ? PN_INFINITE : 0;
+        return true;
+    }
+    if (depth <= 0 || is_repetition(pos)) {
+        if (depth > 0) {
+            ms->repetitions++;
+        }
+        *pn = PN_INFINITE;
+        *dn = 0;
+        return true;
+    }
+    return false;
+}
+
+// A repetition depends on the moves that led to the position, not only on
+// the position, so a disproof that rests on one would be wrong when the
+// table hands it to the same position reached another way. Proofs never
+// rest on one: the fastest mate does not repeat a position.
+static void store_result(MateSearch* ms, uint64_t key, int depth, uint32_t pn, uint32_t dn, uint64_t repetitionsBefore) {
+    if (pn == PN_INFINITE && ms->repetitions != repetitionsBefore) {
+        return;
+    }
+    store(ms, key, depth, pn, dn);
+}
+
+static void to_phi_delta(const MateSearch* ms, uint32_t pn, uint32_t dn, uint32_t* phi, uint32_t* delta) {
+    bool attackerToMove = ms->pos.side == ms->attacker;
+    *phi = attackerToMove ? pn : dn;
+    *delta = attackerToMove ? dn : pn;
+}
+
+static void mid(MateSearch* ms, int depth, uint32_t thPhi, uint32_t thDelta, uint32_t* phiOut, uint32_t* deltaOut) {
+    Position* pos = &ms->pos;
+    uint64_t key = pos->key;
+    bool attackerToMove = pos->side == ms->attacker;
+    uint64_t repetitionsBefore = ms->repetitions;
+    ms->nodes++;
+    if ((ms->nodes & 4095) == 0 && ms->stopSignal && SDL_AtomicGet(ms->stopSignal)) {
+        ms->aborted = true;
+    }
+    if (ms->nodes >= ms->nodeLimit) {
+        ms->aborted = true;
+    }
+
+    MoveList list;
+    generate_legal_moves(pos, &list);
+    uint32_t pn, dn;
+    if (terminal(ms, &list, depth, &pn, &dn)) {
+        store_result(ms, key, depth, pn, dn, repetitionsBefore);
+        to_phi_delta(ms, pn, dn, phiOut, deltaOut);
+        return;
+    }
+
+    // Children start from the table or, when unseen, from a small estimate:
+    // a check leaves the defender few replies, so it is cheaper to prove
+    uint32_t childPhi[MAX_MOVES];
+    uint32_t childDelta[MAX_MOVES];
+    for (int i = 0; i < list.count; i++) {
+        make_move(pos, list.moves[i]);
+        uint32_t childPn, childDn;
+        probe(ms, pos->key, depth - 1, &childPn, &childDn);
+        if (childPn == 1 && childDn == 1 && attackerToMove && !in_check(pos)) {
+            childPn = 2;
+        }
+        to_phi_delta(ms, childPn, childDn, &childPhi[i], &childDelta[i]);
+        unmake_move(pos, list.moves[i]);
+    }
+
+    uint32_t phi, delta;
+    for (;;) {
+        // The side to move needs one child that works for it and all of
+        // them to fail before it fails
+        int best = 0;
+        uint32_t second = PN_INFINITE;
+        phi = PN_INFINITE;
+        delta = 0;
+        for (int i = 0; i < list.count; i++) {
+            if (childDelta[i] < phi) {
+                second = phi;
+                phi = childDelta[i];
+                best = i;
+            } else if (childDelta[i] < second) {
+                second = childDelta[i];
+            }
+            delta = add_numbers(delta, childPhi[i]);
+        }
+        if (phi >= thPhi || delta >= thDelta || ms->aborted) {
+            break;
+        }
+
+        uint32_t childThPhi = thDelta >= PN_INFINITE ? PN_INFINITE
+                            : add_numbers(thDelta - delta, childPhi[best]);
+        uint32_t childThDelta = thPhi < add_numbers(second, 1) ? thPhi : add_numbers(second, 1);
+        make_move(pos, list.moves[best]);
+        mid(ms, depth - 1, childThPhi, childThDelta, &childPhi[best], &childDelta[best]);
+        unmake_move(pos, list.moves[best]);
+    }
+
+    store_result(ms, key, depth, attackerToMove ? phi : delta, attackerToMove ? delta : phi, repetitionsBefore);
+    *phiOut = phi;
+    *deltaOut = delta;
+}
+
+// Searches the current position to a resolution within depth plies;
+// returns true when it is a proven mate for the attacker
+static bool prove(MateSearch* ms, int depth) {
+    uint32_t phi, delta;
+    mid(ms, depth, PN_INFINITE, PN_INFINITE, &phi, &delta);
+    uint32_t pn = (ms->pos.side == ms->attacker) ? phi : delta;
+    return pn == 0 && !ms->aborted;
+}
+
+// Fewest plies, counted in steps of two from first, in which the current
+// position is proven; -1 if not within maxDepth
+static int shortest_proof(MateSearch* ms, int first, int maxDepth) {
+    for (int depth = first; depth <= maxDepth && !ms->aborted; depth += 2) {
+        if (prove(ms, depth)) {
+            return depth;
+        }
+    }
+    return -1;
+}
+
+// Walks down a proven tree choosing the attacker's fastest mate and the
+// defender's slowest loss at each step
+static int extract_line(MateSearch* ms, int depth, Move* line) {
+    Position* pos = &ms->pos;
+    int length = 0;
+    while (depth > 0 && length < MAX_PLY && !ms->aborted) {
+        MoveList list;
+        generate_legal_moves(pos, &list);
+        if (list.count == 0) {
+            break;
+        }
+
+        bool attackerToMove = pos->side == ms->attacker;
+        int chosen = -1;
+        int chosenDepth = attackerToMove ? depth + 1 : -1;
+        for (int i = 0; i < list.count; i++) {
+            make_move(pos, list.moves[i]);
+            int childDepth = shortest_proof(ms, attackerToMove ? 0 : 1, depth - 1);
+            unmake_move(pos, list.moves[i]);
+            if (childDepth < 0) {
+                continue;
+            }
+            if (attackerToMove ? childDepth < chosenDepth : childDepth > chosenDepth) {
+                chosen = i;
+                chosenDepth = childDepth;
+            }
+        }
+        if (chosen < 0) {
+            break;
+        }
+        line[length++] = list.moves[chosen];
+        make_move(pos, list.moves[chosen]);
+        depth = chosenDepth;
+    }
+
+    for (int i = length - 1; i >= 0; i--) {
+        unmake_move(pos, line[i]);
+    }
+    return length;
+}
+
+bool mate_search(const Position* pos, int maxMoves, uint64_t nodeLimit, SDL_atomic_t* stopSignal, MateResult* result) {
+    memset(result, 0, sizeof(*result));
+    uint64_t start = SDL_GetPerformanceCounter();
+
+    MateSearch* ms = malloc(sizeof(MateSearch));
+    MateEntry* table = calloc((size_t)1 << MATE_TABLE_BITS, sizeof(MateEntry));
+    if (!ms || !table) {
+        printf("Error allocating the mate search table\n");
+        free(ms);
+        free(table);
+        return false;
+    }
+    ms->pos = *pos;
+    ms->attacker = pos->side;
+    ms->table = table;
+    ms->nodes = 0;
+    ms->nodeLimit = nodeLimit;
+    ms->stopSignal = stopSignal;
+    ms->aborted = false;
+    ms->repetitions = 0;
+
+    if (maxMoves <= 0 || maxMoves > MATE_MAX_MOVES) {
+        maxMoves = MATE_MAX_MOVES;
+    }
+    result->maxMoves = maxMoves;
+    int plies = shortest_proof(ms, 1, 2 * maxMoves - 1);
+    if (plies > 0) {
+        result->found = true;
+        result->mateIn = (plies + 1) / 2;
+        // The line is worth a little more search than the proof itself
+        ms->nodeLimit = ms->nodes + nodeLimit;
+        result->length = extract_line(ms, plies, result->line);
+    }
+    result->complete = !ms->aborted;
+    result->nodes = ms->nodes;
+    result->elapsed = (int)((SDL_GetPerformanceCounter() - start) * 1000 / SDL_GetPerformanceFrequency());
+
+    free(table);
+    free(ms);
+    return result->found;
+}
+
+// "Mate in 3: Qxh7+ Kxh7 Rh3+ Kg8 Rh8#", or why none was given
+void mate_format_line(const Position* root, const MateResult* result, char* text, int size) {
+    if (!result->found) {
+        // Repetitions count as defences, so only the bound is proven
+        if (result->complete) {
+            snprintf(text, size, "No mate in %d move%s", result->maxMoves, result->maxMoves == 1 ? "" : "s");
+        } else {
+            snprintf(text, size, "No mate found within %llu nodes", (unsigned long long)result->nodes);
+        }
+        return;
+    }
+    int length = snprintf(text, size, "Mate in %d:", result->mateIn);
+    Position pos = *root;
+    for (int i = 0; i < result->length && length < size; i++) {
+        char san[16];
+        move_to_san(&pos, result->line[i], san);
+        if (length + (int)strlen(san) + 2 >= size || !make_move(&pos, result->line[i])) {
+            break;
+        }
+        length += snprintf(text + length, size - length, " %s", san);
+    }
+}
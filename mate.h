@@ -0,0 +1,24 @@
+#ifndef MATE_H
+#define MATE_H
+
+#include <SDL2/SDL.h>
+#include "engine.h"
+
+#define MATE_DEFAULT_NODES 5000000
+#define MATE_MAX_MOVES 16
+
+typedef struct {
+    bool found;
+    bool complete;          // false if the node budget ran out first
+    int mateIn;             // moves, 0 when no mate was found
+    int maxMoves;           // bound searched; a mate may still exist past it
+    int length;             // plies in line
+    Move line[MAX_PLY];     // mating line with the defender's longest defence
+    uint64_t nodes;
+    int elapsed;            // milliseconds
+} MateResult;
+
+bool mate_search(const Position* pos, int maxMoves, uint64_t nodeLimit, SDL_atomic_t* stopSignal, MateResult* result);
+void mate_format_line(const Position* root, const MateResult* result, char* text, int size);
+
+#endif
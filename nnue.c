@@ -0,0 +1,313 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <SDL2/SDL.h>
+#include "nnue.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NNUE_X86
+#include <immintrin.h>
+#endif
+
+// Weight file layout, all little-endian, in this order:
+//   char[8]  "CHESSNN1"
+//   int16    feature biases  [NNUE_HIDDEN]
+//   int16    feature weights [NNUE_FEATURES][NNUE_HIDDEN]
+//   int32    layer 1 biases  [NNUE_L2]
+//   int8     layer 1 weights [NNUE_L2][2 * NNUE_HIDDEN]
+//   int32    layer 2 biases  [NNUE_L3]
+//   int8     layer 2 weights [NNUE_L3][NNUE_L2]
+//   int32    output bias
+//   int8     output weights  [NNUE_L3]
+#define NNUE_MAGIC "CHESSNN1"
+
+// Dense layer outputs are scaled down by 2^6 before clipping to 0..127, and
+// the final output by 16 to give centipawns
+#define WEIGHT_SCALE_BITS 6
+#define OUTPUT_SCALE 16
+
+typedef void (*DenseKernel)(const uint8_t* input, const int8_t* weights, const int32_t* biases,
+                            int32_t* output, int inputs, int outputs);
+
+static struct {
+    bool loaded;
+    int16_t* featureBiases;
+    int16_t* featureWeights;
+    int32_t* l1Biases;
+    int8_t* l1Weights;
+    int32_t* l2Biases;
+    int8_t* l2Weights;
+    int32_t* outputBias;
+    int8_t* outputWeights;
+} network;
+
+static const int16_t zeroRow[NNUE_HIDDEN];
+static NnueKernel selectedKernel = NNUE_KERNEL_SCALAR;
+static DenseKernel dense = NULL;
+
+static void dense_scalar(const uint8_t* input, const int8_t* weights, const int32_t* biases,
+                         int32_t* output, int inputs, int outputs) {
+    for (int j = 0; j < outputs; j++) {
+        const int8_t* row = weights + j * inputs;
+        int32_t sum = biases[j];
+        for (int i = 0; i < inputs; i++) {
+            sum += input[i] * row[i];
+        }
+        output[j] = sum;
+    }
+}
+
+#ifdef NNUE_X86
+// Inputs are clipped to 0..127, so the pairwise u8 x i8 products summed by
+// maddubs stay below the int16 saturation limit
+__attribute__((target("sse4.1")))
+static void dense_sse41(const uint8_t* input, const int8_t* weights, const int32_t* biases,
+                        int32_t* output, int inputs, int outputs) {
+    const __m128i ones = _mm_set1_epi16(1);
+    for (int j = 0; j < outputs; j += 4) {
+        const int8_t* row = weights + j * inputs;
+        __m128i sum0 = _mm_setzero_si128(), sum1 = sum0, sum2 = sum0, sum3 = sum0;
+        for (int i = 0; i < inputs; i += 16) {
+            __m128i in = _mm_load_si128((const __m128i*)(input + i));
+            __m128i w0 = _mm_load_si128((const __m128i*)(row + i));
+            __m128i w1 = _mm_load_si128((const __m128i*)(row + inputs + i));
+            __m128i w2 = _mm_load_si128((const __m128i*)(row + 2 * inputs + i));
+            __m128i w3 = _mm_load_si128((const __m128i*)(row + 3 * inputs + i));
+            sum0 = _mm_add_epi32(sum0, _mm_madd_epi16(_mm_maddubs_epi16(in, w0), ones));
+            sum1 = _mm_add_epi32(sum1, _mm_madd_epi16(_mm_maddubs_epi16(in, w1), ones));
+            sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(_mm_maddubs_epi16(in, w2), ones));
+            sum3 = _mm_add_epi32(sum3, _mm_madd_epi16(_mm_maddubs_epi16(in, w3), ones));
+        }
+        __m128i four = _mm_hadd_epi32(_mm_hadd_epi32(sum0, sum1), _mm_hadd_epi32(sum2, sum3));
+        four = _mm_add_epi32(four, _mm_loadu_si128((const __m128i*)(biases + j)));
+        _mm_storeu_si128((__m128i*)(output + j), four);
+    }
+}
+
+__attribute__((target("avx2")))
+static void dense_avx2(const uint8_t* input, const int8_t* weights, const int32_t* biases,
+                       int32_t* output, int inputs, int outputs) {
+    // Narrow layers fall back to the 16-byte kernel
+    if (inputs % 32 != 0) {
+        dense_sse41(input, weights, biases, output, inputs, outputs);
+        return;
+    }
+    // Four output rows at a time share each input load and one horizontal sum
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (int j = 0; j < outputs; j += 4) {
+        const int8_t* row = weights + j * inputs;
+        __m256i sum0 = _mm256_setzero_si256(), sum1 = sum0, sum2 = sum0, sum3 = sum0;
+        for (int i = 0; i < inputs; i += 32) {
+            __m256i in = _mm256_load_si256((const __m256i*)(input + i));
+            __m256i w0 = _mm256_load_si256((const __m256i*)(row + i));
+            __m256i w1 = _mm256_load_si256((const __m256i*)(row + inputs + i));
+            __m256i w2 = _mm256_load_si256((const __m256i*)(row + 2 * inputs + i));
+            __m256i w3 = _mm256_load_si256((const __m256i*)(row + 3 * inputs + i));
+            sum0 = _mm256_add_epi32(sum0, _mm256_madd_epi16(_mm256_maddubs_epi16(in, w0), ones));
+            sum1 = _mm256_add_epi32(sum1, _mm256_madd_epi16(_mm256_maddubs_epi16(in, w1), ones));
+            sum2 = _mm256_add_epi32(sum2, _mm256_madd_epi16(_mm256_maddubs_epi16(in, w2), ones));
+            sum3 = _mm256_add_epi32(sum3, _mm256_madd_epi16(_mm256_maddubs_epi16(in, w3), ones));
+        }
+        __m256i sum = _mm256_hadd_epi32(_mm256_hadd_epi32(sum0, sum1), _mm256_hadd_epi32(sum2, sum3));
+        __m128i four = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        four = _mm_add_epi32(four, _mm_loadu_si128((const __m128i*)(biases + j)));
+        _mm_storeu_si128((__m128i*)(output + j), four);
+    }
+}
+#endif
+
+// Picks the widest kernel the CPU supports. CHESS_NNUE_KERNEL=scalar, sse41 or
+// avx2 forces a kernel, which is how the kernels are compared against each other.
+static void select_kernel(void) {
+    const char* forced = SDL_getenv("CHESS_NNUE_KERNEL");
+    selectedKernel = NNUE_KERNEL_SCALAR;
+    dense = dense_scalar;
+#ifdef NNUE_X86
+    if (SDL_HasAVX2() && (!forced || strcmp(forced, "avx2") == 0)) {
+        selectedKernel = NNUE_KERNEL_AVX2;
+        dense = dense_avx2;
+    } else if (SDL_HasSSE41() && (!forced || strcmp(forced, "sse41") == 0)) {
+        selectedKernel = NNUE_KERNEL_SSE41;
+        dense = dense_sse41;
+    }
+#endif
+}
+
+NnueKernel nnue_kernel(void) {
+    return selectedKernel;
+}
+
+const char* nnue_kernel_name(void) {
+    switch (selectedKernel) {
+        case NNUE_KERNEL_AVX2: return "avx2";
+        case NNUE_KERNEL_SSE41: return "sse4.1";
+        default: return "scalar";
+    }
+}
+
+void nnue_free(void) {
+    SDL_SIMDFree(network.featureBiases);
+    SDL_SIMDFree(network.featureWeights);
+    SDL_SIMDFree(network.l1Biases);
+    SDL_SIMDFree(network.l1Weights);
+    SDL_SIMDFree(network.l2Biases);
+    SDL_SIMDFree(network.l2Weights);
+    SDL_SIMDFree(network.outputBias);
+    SDL_SIMDFree(network.outputWeights);
+    memset(&network, 0, sizeof(network));
+}
+
+static void* read_block(FILE* file, size_t size, bool* ok) {
+    void* block = SDL_SIMDAlloc(size);
+    if (!block || fread(block, 1, size, file) != size) {
+        *ok = false;
+    }
+    return block;
+}
+
+bool nnue_load(const char* filename) {
+    nnue_free();
+
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        printf("Error opening network %s\n", filename);
+        return false;
+    }
+
+    char magic[8];
+    bool ok = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, NNUE_MAGIC, 8) == 0;
+    if (ok) {
+        network.featureBiases = read_block(file, sizeof(int16_t) * NNUE_HIDDEN, &ok);
+        network.featureWeights = read_block(file, sizeof(int16_t) * NNUE_FEATURES * NNUE_HIDDEN, &ok);
+        network.l1Biases = read_block(file, sizeof(int32_t) * NNUE_L2, &ok);
+        network.l1Weights = read_block(file, sizeof(int8_t) * NNUE_L2 * 2 * NNUE_HIDDEN, &ok);
+        network.l2Biases = read_block(file, sizeof(int32_t) * NNUE_L3, &ok);
+        network.l2Weights = read_block(file, sizeof(int8_t) * NNUE_L3 * NNUE_L2, &ok);
+        network.outputBias = read_block(file, sizeof(int32_t), &ok);
+        network.outputWeights = read_block(file, sizeof(int8_t) * NNUE_L3, &ok);
+    }
+    fclose(file);
+
+    if (!ok) {
+        printf("Invalid or truncated network file %s\n", filename);
+        nnue_free();
+        return false;
+    }
+
+    select_kernel();
+    network.loaded = true;
+    return true;
+}
+
+bool nnue_loaded(void) {
+    return network.loaded;
+}
+
+// Each perspective sees its own side at the bottom of the board
+static int orient(int perspective, int sq) {
+    return perspective == SIDE_WHITE ? sq : sq ^ 56;
+}
+
+static int feature_index(int perspective, int kingSq, char piece, int sq) {
+    // piece_index() orders pnbrq before PNBRQ, so % 6 gives the piece type
+    int slot = (piece_index(piece) % 6) * 2 + (piece_side(piece) != perspective);
+    return orient(perspective, kingSq) * 640 + slot * 64 + orient(perspective, sq);
+}
+
+static const int16_t* feature_row(int index) {
+    return network.featureWeights + (size_t)index * NNUE_HIDDEN;
+}
+
+// The accumulator loops have a fixed length and restrict-qualified operands
+// so the compiler vectorizes them without runtime overlap checks
+static void add_feature(int16_t* restrict values, const int16_t* restrict row) {
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        values[i] += row[i];
+    }
+}
+
+// Copies the parent accumulator and applies the changed rows in one pass
+static void apply_rows(int16_t* restrict values, const int16_t* restrict previous, const int16_t* restrict removed,
+                       const int16_t* restrict added, const int16_t* restrict taken) {
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        values[i] = previous[i] - removed[i] + added[i] - taken[i];
+    }
+}
+
+static void refresh_perspective(NnueAccumulator* acc, const Position* pos, int perspective) {
+    int16_t* values = acc->values[perspective];
+    int kingSq = pos->kingSquare[perspective];
+    memcpy(values, network.featureBiases, sizeof(int16_t) * NNUE_HIDDEN);
+    for (int sq = 0; sq < 64; sq++) {
+        char piece = pos->board[SQUARE_ROW(sq)][SQUARE_COL(sq)];
+        if (piece != ' ' && tolower((unsigned char)piece) != 'k') {
+            add_feature(values, feature_row(feature_index(perspective, kingSq, piece, sq)));
+        }
+    }
+}
+
+void nnue_refresh(NnueAccumulator* acc, const Position* pos) {
+    refresh_perspective(acc, pos, SIDE_WHITE);
+    refresh_perspective(acc, pos, SIDE_BLACK);
+}
+
+// Updates the accumulator for a move already made on pos. Only the rows of
+// the pieces that changed are touched, except that a king move refreshes its
+// own side's perspective because every feature there depends on the king.
+void nnue_update(NnueAccumulator* acc, const NnueAccumulator* parent, const Position* pos, Move move) {
+    bool kingMove = tolower((unsigned char)move.piece) == 'k';
+    char placed = (move.promotion != ' ') ? move.promotion : move.piece;
+
+    for (int perspective = 0; perspective < 2; perspective++) {
+        if (kingMove && piece_side(move.piece) == perspective) {
+            refresh_perspective(acc, pos, perspective);
+            continue;
+        }
+
+        // The other side's king move only changes that perspective by the
+        // piece it captured
+        int kingSq = pos->kingSquare[perspective];
+        const int16_t* removed = kingMove ? zeroRow : feature_row(feature_index(perspective, kingSq, move.piece, move.from));
+        const int16_t* added = kingMove ? zeroRow : feature_row(feature_index(perspective, kingSq, placed, move.to));
+        const int16_t* taken = move.captured == ' ' ? zeroRow
+                                                    : feature_row(feature_index(perspective, kingSq, move.captured, move.to));
+        apply_rows(acc->values[perspective], parent->values[perspective], removed, added, taken);
+    }
+}
+
+static void clip_accumulator(const int16_t* restrict values, uint8_t* restrict output) {
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        int value = values[i];
+        output[i] = value < 0 ? 0 : value > 127 ? 127 : value;
+    }
+}
+
+static void clipped_relu(const int32_t* restrict input, uint8_t* restrict output, int count) {
+    for (int i = 0; i < count; i++) {
+        int value = input[i] >> WEIGHT_SCALE_BITS;
+        output[i] = value < 0 ? 0 : value > 127 ? 127 : value;
+    }
+}
+
+// Score from the side to move's point of view, in centipawns
+int nnue_evaluate(const NnueAccumulator* acc, const Position* pos) {
+    _Alignas(32) uint8_t transformed[2 * NNUE_HIDDEN];
+    _Alignas(32) int32_t l1Out[NNUE_L2];
+    _Alignas(32) uint8_t l1Act[NNUE_L2];
+    _Alignas(32) int32_t l2Out[NNUE_L3];
+    _Alignas(32) uint8_t l2Act[NNUE_L3];
+    int32_t output;
+
+    // Side to move's accumulator first
+    for (int half = 0; half < 2; half++) {
+        clip_accumulator(acc->values[half == 0 ? pos->side : pos->side ^ 1], transformed + half * NNUE_HIDDEN);
+    }
+
+    dense(transformed, network.l1Weights, network.l1Biases, l1Out, 2 * NNUE_HIDDEN, NNUE_L2);
+    clipped_relu(l1Out, l1Act, NNUE_L2);
+    dense(l1Act, network.l2Weights, network.l2Biases, l2Out, NNUE_L2, NNUE_L3);
+    clipped_relu(l2Out, l2Act, NNUE_L3);
+    dense_scalar(l2Act, network.outputWeights, network.outputBias, &output, NNUE_L3, 1);
+
+    return output / OUTPUT_SCALE;
+}
@@ -0,0 +1,35 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include "engine.h"
+
+// HalfKP network: each side's king square combined with every other piece
+// and its square feeds a 256-wide int16 accumulator per perspective. The two
+// accumulators (side to move first) go through three small int8 dense layers
+// 512 -> 32 -> 32 -> 1.
+#define NNUE_HIDDEN 256
+#define NNUE_L2 32
+#define NNUE_L3 32
+#define NNUE_FEATURES (64 * 10 * 64)
+
+typedef struct {
+    int16_t values[2][NNUE_HIDDEN]; // [perspective][neuron]
+} NnueAccumulator;
+
+typedef enum {
+    NNUE_KERNEL_SCALAR,
+    NNUE_KERNEL_SSE41,
+    NNUE_KERNEL_AVX2
+} NnueKernel;
+
+bool nnue_load(const char* filename);
+bool nnue_loaded(void);
+void nnue_free(void);
+NnueKernel nnue_kernel(void);
+const char* nnue_kernel_name(void);
+
+void nnue_refresh(NnueAccumulator* acc, const Position* pos);
+void nnue_update(NnueAccumulator* acc, const NnueAccumulator* parent, const Position* pos, Move move);
+int nnue_evaluate(const NnueAccumulator* acc, const Position* pos);
+
+#endif
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL_image.h>
+#include "pieces.h"
+#include "resources.h"
+
+// Blank pixels between sprites so filtering at a sprite's edge never picks
+// up its neighbour
+#define ATLAS_PADDING 2
+
+// Image of each sprite, in the order piece_sprite numbers them
+static const char* imageFiles[PIECE_TYPES] = {
+    "images/wp.png",
+    "images/bp.png",
+    "images/wk.png",
+    "images/bk.png",
+    "images/wq.png",
+    "images/bq.png",
+    "images/wr.png",
+    "images/br.png",
+    "images/wb.png",
+    "images/bb.png",
+    "images/wh.png",
+    "images/bh.png"
+};
+
+// Lowercase pieces use the white images
+int piece_sprite(char piece) {
+    static const char order[] = "pPkKqQrRbBnN";
+    const char* found = piece != ' ' && piece != '\0' ? strchr(order, piece) : NULL;
+    return found ? (int)(found - order) : -1;
+}
+
+// Halves an ARGB8888 surface with a 2x2 box filter. The colours are
+// weighted by alpha so the transparent background does not darken the
+// outlines.
+static SDL_Surface* halve_surface(SDL_Surface* src) {
+    int w = SDL_max(src->w / 2, 1);
+    int h = SDL_max(src->h / 2, 1);
+    SDL_Surface* dst = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!dst) {
+        return NULL;
+    }
+    for (int y = 0; y < h; y++) {
+        const Uint32* rows[2] = {
+            (const Uint32*)((const Uint8*)src->pixels + SDL_min(2 * y, src->h - 1) * src->pitch),
+            (const Uint32*)((const Uint8*)src->pixels + SDL_min(2 * y + 1, src->h - 1) * src->pitch)
+        };
+        Uint32* out = (Uint32*)((Uint8*)dst->pixels + y * dst->pitch);
+        for (int x = 0; x < w; x++) {
+            Uint32 a = 0, r = 0, g = 0, b = 0;
+            for (int i = 0; i < 4; i++) {
+                Uint32 p = rows[i / 2][SDL_min(2 * x + i % 2, src->w - 1)];
+                Uint32 alpha = p >> 24;
+                a += alpha;
+                r += ((p >> 16) & 0xFF) * alpha;
+                g += ((p >> 8) & 0xFF) * alpha;
+                b += (p & 0xFF) * alpha;
+            }
+            out[x] = a == 0 ? 0 : ((a / 4) << 24) | ((r / a) << 16) | ((g / a) << 8) | (b / a);
+        }
+    }
+    return dst;
+}
+
+// Resamples an image to w x h once, so drawing copies it pixel for pixel.
+// Halving first down a mip chain keeps a large reduction from skipping
+// pixels; a linear stretch covers the last factor of less than two.
+static SDL_Surface* prescale(SDL_Surface* image, int w, int h) {
+    SDL_Surface* level = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_ARGB8888, 0);
+    while (level && level->w >= 2 * w && level->h >= 2 * h) {
+        SDL_Surface* next = halve_surface(level);
+        SDL_FreeSurface(level);
+        level = next;
+    }
+    if (!level || (level->w == w && level->h == h)) {
+        return level;
+    }
+    SDL_Surface* scaled = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (scaled && SDL_SoftStretchLinear(level, NULL, scaled, NULL) != 0) {
+        SDL_FreeSurface(scaled);
+        scaled = NULL;
+    }
+    SDL_FreeSurface(level);
+    return scaled;
+}
+
+// Loads the images, resampled to spriteW x spriteH (their own size when
+// that is 0), and copies them into one sheet, six cells wide with the white
+// pieces on the top row, which keeps it well inside the texture size
+// limits. A missing image leaves an empty sprite and the rest still load.
+bool pieces_load(PieceAtlas* atlas, SDL_Renderer* renderer, int spriteW, int spriteH) {
+    memset(atlas, 0, sizeof(*atlas));
+    SDL_Surface* images[PIECE_TYPES] = {NULL};
+    int cellW = 0, cellH = 0;
+    for (int i = 0; i < PIECE_TYPES; i++) {
+        images[i] = IMG_Load(imageFiles[i]);
+        if (!images[i]) {
+            printf("Error loading image from %s: %s\n", imageFiles[i], IMG_GetError());
+            continue;
+        }
+        if (spriteW > 0 && spriteH > 0) {
+            SDL_Surface* scaled = prescale(images[i], spriteW, spriteH);
+            SDL_FreeSurface(images[i]);
+            images[i] = scaled;
+            if (!scaled) {
+                printf("Error scaling %s: %s\n", imageFiles[i], SDL_GetError());
+                continue;
+            }
+        }
+        cellW = SDL_max(cellW, images[i]->w + ATLAS_PADDING);
+        cellH = SDL_max(cellH, images[i]->h + ATLAS_PADDING);
+    }
+    for (int i = 0; i < PIECE_TYPES; i++) {
+        if (images[i]) {
+            atlas->sources[i] = (SDL_Rect){(i / 2) * cellW, (i % 2) * cellH, images[i]->w, images[i]->h};
+        }
+    }
+
+    SDL_Surface* sheet = cellW > 0 ? SDL_CreateRGBSurfaceWithFormat(0, cellW * PIECE_TYPES / 2, cellH * 2, 32, SDL_PIXELFORMAT_ARGB8888) : NULL;
+    if (sheet) {
+        SDL_FillRect(sheet, NULL, 0);
+        for (int i = 0; i < PIECE_TYPES; i++) {
+            if (images[i]) {
+                // Copy the alpha as it is instead of blending onto the sheet
+                SDL_SetSurfaceBlendMode(images[i], SDL_BLENDMODE_NONE);
+                SDL_Rect dst = atlas->sources[i];
+                SDL_BlitSurface(images[i], NULL, sheet, &dst);
+            }
+        }
+        atlas->texture = resource_texture_from_surface(renderer, sheet, "piece atlas");
+    }
+    if (atlas->texture) {
+        SDL_SetTextureBlendMode(atlas->texture, SDL_BLENDMODE_BLEND);
+        // Sprites sliding between squares land between pixels
+        SDL_SetTextureScaleMode(atlas->texture, SDL_ScaleModeLinear);
+        atlas->w = sheet->w;
+        atlas->h = sheet->h;
+    } else {
+        printf("Error building the piece atlas: %s\n", SDL_GetError());
+    }
+
+    for (int i = 0; i < PIECE_TYPES; i++) {
+        SDL_FreeSurface(images[i]);
+    }
+    SDL_FreeSurface(sheet);
+    return atlas->texture != NULL;
+}
+
+void pieces_free(PieceAtlas* atlas) {
+    resource_release(atlas->texture);
+    memset(atlas, 0, sizeof(*atlas));
+}
+
+void sprite_batch_begin(SpriteBatch* batch, const PieceAtlas* atlas) {
+    batch->atlas = atlas;
+    batch->count = 0;
+}
+
+// Queues a piece stretched over dst, drawn with the given opacity. A full
+// batch is drawn first to make room.
+void sprite_batch_add(SpriteBatch* batch, SDL_Renderer* renderer, char piece, const SDL_FRect* dst, Uint8 alpha) {
+    const PieceAtlas* atlas = batch->atlas;
+    int sprite = piece_sprite(piece);
+    if (sprite < 0 || !atlas->texture || atlas->sources[sprite].w == 0) {
+        return;
+    }
+    if (batch->count == PIECE_BATCH) {
+        sprite_batch_flush(batch, renderer);
+    }
+
+    const SDL_Rect* src = &atlas->sources[sprite];
+    float u0 = (float)src->x / atlas->w;
+    float v0 = (float)src->y / atlas->h;
+    float u1 = (float)(src->x + src->w) / atlas->w;
+    float v1 = (float)(src->y + src->h) / atlas->h;
+    SDL_Color color = {255, 255, 255, alpha};
+    SDL_Vertex* v = &batch->vertices[batch->count * 4];
+    v[0] = (SDL_Vertex){{dst->x, dst->y}, color, {u0, v0}};
+    v[1] = (SDL_Vertex){{dst->x + dst->w, dst->y}, color, {u1, v0}};
+    v[2] = (SDL_Vertex){{dst->x + dst->w, dst->y + dst->h}, color, {u1, v1}};
+    v[3] = (SDL_Vertex){{dst->x, dst->y + dst->h}, color, {u0, v1}};
+
+    // Two triangles per sprite
+    int base = batch->count * 4;
+    int* index = &batch->indices[batch->count * 6];
+    index[0] = base;
+    index[1] = base + 1;
+    index[2] = base + 2;
+    index[3] = base;
+    index[4] = base + 2;
+    index[5] = base + 3;
+    batch->count++;
+}
+
+void sprite_batch_flush(SpriteBatch* batch, SDL_Renderer* renderer) {
+    if (batch->count > 0) {
+        SDL_RenderGeometry(renderer, batch->atlas->texture, batch->vertices, batch->count * 4,
+                           batch->indices, batch->count * 6);
+    }
+    batch->count = 0;
+}
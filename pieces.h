@@ -0,0 +1,38 @@
+#ifndef PIECES_H
+#define PIECES_H
+
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+
+// The twelve piece images packed side by side into one texture at load
+// time, so a whole position draws as a single batch of textured quads
+// instead of one copy, and one texture switch, per piece. The images are
+// resampled to the size they are drawn at while loading, rather than
+// scaled down by the GPU on every draw.
+
+#define PIECE_TYPES 12
+#define PIECE_BATCH 64          // sprites per SDL_RenderGeometry call
+
+typedef struct {
+    SDL_Texture* texture;
+    int w, h;                   // of the texture
+    SDL_Rect sources[PIECE_TYPES];
+} PieceAtlas;
+
+// Quads waiting to be drawn from one atlas
+typedef struct {
+    const PieceAtlas* atlas;
+    SDL_Vertex vertices[PIECE_BATCH * 4];
+    int indices[PIECE_BATCH * 6];
+    int count;
+} SpriteBatch;
+
+bool pieces_load(PieceAtlas* atlas, SDL_Renderer* renderer, int spriteW, int spriteH);
+void pieces_free(PieceAtlas* atlas);
+int piece_sprite(char piece);
+
+void sprite_batch_begin(SpriteBatch* batch, const PieceAtlas* atlas);
+void sprite_batch_add(SpriteBatch* batch, SDL_Renderer* renderer, char piece, const SDL_FRect* dst, Uint8 alpha);
+void sprite_batch_flush(SpriteBatch* batch, SDL_Renderer* renderer);
+
+#endif
@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_image.h>
+#include "resources.h"
+
+#define RESOURCE_NAME_LENGTH 96
+
+typedef struct {
+    ResourceType type;
+    void* handle;
+    int refs;
+    bool shared;                // found again by name when loaded twice
+    char name[RESOURCE_NAME_LENGTH];
+    SDL_Renderer* owner;        // the renderer a texture belongs to
+    size_t bytes;               // texture pixel data
+} Resource;
+
+static Resource* resources = NULL;
+static int resourceCount = 0;
+static int resourceCapacity = 0;
+static size_t textureBytes = 0;
+static size_t peakTextureBytes = 0;
+
+static const char* typeNames[] = {"renderer", "texture", "font", "sound"};
+
+static Resource* find_handle(const void* handle) {
+    for (int i = 0; i < resourceCount; i++) {
+        if (resources[i].handle == handle) {
+            return &resources[i];
+        }
+    }
+    return NULL;
+}
+
+static Resource* find_shared(ResourceType type, const char* name, const SDL_Renderer* owner) {
+    for (int i = 0; i < resourceCount; i++) {
+        Resource* r = &resources[i];
+        if (r->shared && r->type == type && r->owner == owner && strcmp(r->name, name) == 0) {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+// Registers a new handle with one reference. A failed allocation of the
+// table leaves the handle unregistered but still usable.
+static void add_resource(ResourceType type, void* handle, const char* name, bool shared, SDL_Renderer* owner) {
+    if (resourceCount == resourceCapacity) {
+        int capacity = resourceCapacity ? resourceCapacity * 2 : 64;
+        Resource* grown = realloc(resources, capacity * sizeof(Resource));
+        if (!grown) {
+            printf("Out of memory registering %s %s\n", typeNames[type], name);
+            return;
+        }
+        resources = grown;
+        resourceCapacity = capacity;
+    }
+    Resource* r = &resources[resourceCount++];
+    memset(r, 0, sizeof(*r));
+    r->type = type;
+    r->handle = handle;
+    r->refs = 1;
+    r->shared = shared;
+    r->owner = owner;
+    snprintf(r->name, sizeof(r->name), "%s", name ? name : "");
+
+    if (type == RESOURCE_TEXTURE) {
+        Uint32 format;
+        int w, h;
+        if (SDL_QueryTexture(handle, &format, NULL, &w, &h) == 0) {
+            int bytesPerPixel = SDL_BYTESPERPIXEL(format);
+            r->bytes = (size_t)w * h * (bytesPerPixel ? bytesPerPixel : 4);
+        }
+        textureBytes += r->bytes;
+        if (textureBytes > peakTextureBytes) {
+            peakTextureBytes = textureBytes;
+        }
+    }
+}
+
+static void destroy_resource(Resource* r) {
+    switch (r->type) {
+        case RESOURCE_RENDERER:
+            SDL_DestroyRenderer(r->handle);
+            break;
+        case RESOURCE_TEXTURE:
+            SDL_DestroyTexture(r->handle);
+            textureBytes -= r->bytes;
+            break;
+        case RESOURCE_FONT:
+            TTF_CloseFont(r->handle);
+            break;
+        case RESOURCE_SOUND:
+            Mix_FreeChunk(r->handle);
+            break;
+    }
+}
+
+// Order does not matter in the table, so the last entry fills the gap
+static void remove_resource(Resource* r) {
+    *r = resources[--resourceCount];
+}
+
+SDL_Renderer* resource_renderer(SDL_Window* window, Uint32 flags) {
+    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, flags);
+    if (renderer) {
+        add_resource(RESOURCE_RENDERER, renderer, "renderer", false, NULL);
+    }
+    return renderer;
+}
+
+SDL_Texture* resource_load_texture(SDL_Renderer* renderer, const char* path) {
+    Resource* found = find_shared(RESOURCE_TEXTURE, path, renderer);
+    if (found) {
+        found->refs++;
+        return found->handle;
+    }
+    SDL_Texture* texture = IMG_LoadTexture(renderer, path);
+    if (texture) {
+        add_resource(RESOURCE_TEXTURE, texture, path, true, renderer);
+    }
+    return texture;
+}
+
+SDL_Texture* resource_texture_from_surface(SDL_Renderer* renderer, SDL_Surface* surface, const char* name) {
+    SDL_Texture* texture = surface ? SDL_CreateTextureFromSurface(renderer, surface) : NULL;
+    if (texture) {
+        add_resource(RESOURCE_TEXTURE, texture, name, false, renderer);
+    }
+    return texture;
+}
+
+SDL_Texture* resource_create_texture(SDL_Renderer* renderer, Uint32 format, int access, int w, int h, const char* name) {
+    SDL_Texture* texture = SDL_CreateTexture(renderer, format, access, w, h);
+    if (texture) {
+        add_resource(RESOURCE_TEXTURE, texture, name, false, renderer);
+    }
+    return texture;
+}
+
+TTF_Font* resource_font(const char* path, int size) {
+    char name[RESOURCE_NAME_LENGTH];
+    snprintf(name, sizeof(name), "%s@%d", path, size);
+    Resource* found = find_shared(RESOURCE_FONT, name, NULL);
+    if (found) {
+        found->refs++;
+        return found->handle;
+    }
+    TTF_Font* font = TTF_OpenFont(path, size);
+    if (font) {
+        add_resource(RESOURCE_FONT, font, name, true, NULL);
+    }
+    return font;
+}
+
+Mix_Chunk* resource_sound(const char* path) {
+    Resource* found = find_shared(RESOURCE_SOUND, path, NULL);
+    if (found) {
+        found->refs++;
+        return found->handle;
+    }
+    Mix_Chunk* chunk = Mix_LoadWAV(path);
+    if (chunk) {
+        add_resource(RESOURCE_SOUND, chunk, path, true, NULL);
+    }
+    return chunk;
+}
+
+void resource_retain(const void* handle) {
+    Resource* r = handle ? find_handle(handle) : NULL;
+    if (r) {
+        r->refs++;
+    }
+}
+
+// Releasing NULL does nothing, like the SDL destroy functions. A renderer
+// takes the textures created on it along when it goes.
+void resource_release(const void* handle) {
+    Resource* r = handle ? find_handle(handle) : NULL;
+    if (!r) {
+#ifndef NDEBUG
+        if (handle) {
+            printf("Released a handle the registry does not own: %p\n", handle);
+        }
+#endif
+        return;
+    }
+    if (--r->refs > 0) {
+        return;
+    }
+    if (r->type == RESOURCE_RENDERER) {
+        SDL_Renderer* renderer = r->handle;
+        for (int i = resourceCount - 1; i >= 0; i--) {
+            if (resources[i].owner == renderer) {
+#ifndef NDEBUG
+                printf("Texture %s outlived its renderer\n", resources[i].name);
+#endif
+                destroy_resource(&resources[i]);
+                remove_resource(&resources[i]);
+            }
+        }
+        r = find_handle(renderer);
+    }
+    destroy_resource(r);
+    remove_resource(r);
+}
+
+size_t resource_texture_bytes(void) {
+    return textureBytes;
+}
+
+size_t resource_peak_texture_bytes(void) {
+    return peakTextureBytes;
+}
+
+int resource_count(ResourceType type) {
+    int count = 0;
+    for (int i = 0; i < resourceCount; i++) {
+        count += resources[i].type == type;
+    }
+    return count;
+}
+
+void resource_shutdown(void) {
+#ifndef NDEBUG
+    printf("Texture memory: %.1f KB in use, %.1f KB at peak\n",
+           textureBytes / 1024.0, peakTextureBytes / 1024.0);
+    for (int i = 0; i < resourceCount; i++) {
+        printf("Leaked %s %s (%d reference%s)\n", typeNames[resources[i].type], resources[i].name,
+               resources[i].refs, resources[i].refs == 1 ? "" : "s");
+    }
+#endif
+    // Renderers last: destroying one frees its textures behind our back
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < resourceCount; i++) {
+            if ((resources[i].type == RESOURCE_RENDERER) == (pass == 1)) {
+                destroy_resource(&resources[i]);
+            }
+        }
+    }
+    free(resources);
+    resources = NULL;
+    resourceCount = 0;
+    resourceCapacity = 0;
+    textureBytes = 0;
+}
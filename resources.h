@@ -0,0 +1,44 @@
+#ifndef RESOURCES_H
+#define RESOURCES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <SDL2/SDL_mixer.h>
+
+// One registry owns every renderer, texture, font and sound the game
+// creates. Each handle carries a reference count: the functions that hand
+// one out count as a reference, resource_retain adds one and
+// resource_release drops one, destroying the handle when none are left.
+// Loading the same file twice returns the same handle with another
+// reference. resource_shutdown sweeps whatever is still registered, and
+// builds without NDEBUG print each handle it had to sweep along with the
+// texture memory in use.
+
+typedef enum {
+    RESOURCE_RENDERER,
+    RESOURCE_TEXTURE,
+    RESOURCE_FONT,
+    RESOURCE_SOUND
+} ResourceType;
+
+SDL_Renderer* resource_renderer(SDL_Window* window, Uint32 flags);
+SDL_Texture* resource_load_texture(SDL_Renderer* renderer, const char* path);
+SDL_Texture* resource_texture_from_surface(SDL_Renderer* renderer, SDL_Surface* surface, const char* name);
+SDL_Texture* resource_create_texture(SDL_Renderer* renderer, Uint32 format, int access, int w, int h, const char* name);
+TTF_Font* resource_font(const char* path, int size);
+Mix_Chunk* resource_sound(const char* path);
+
+void resource_retain(const void* handle);
+void resource_release(const void* handle);
+
+// Bytes of pixel data in live textures, and the most there has been
+size_t resource_texture_bytes(void);
+size_t resource_peak_texture_bytes(void);
+int resource_count(ResourceType type);
+
+// Destroys everything still registered, textures before their renderers
+void resource_shutdown(void);
+
+#endif
@@ -0,0 +1,98 @@
+#include "scheduler.h"
+
+static Uint32 wakeEvent = (Uint32)-1;
+
+static Uint32 wake_event_type(void) {
+    if (wakeEvent == (Uint32)-1) {
+        wakeEvent = SDL_RegisterEvents(1);
+    }
+    return wakeEvent;
+}
+
+void scheduler_init(Scheduler* scheduler, SDL_Window* window) {
+    SDL_memset(scheduler, 0, sizeof(*scheduler));
+    scheduler->dirty = true;
+    scheduler->frameMs = 1000 / 60;
+    wake_event_type();
+
+    SDL_DisplayMode mode;
+    int display = window ? SDL_GetWindowDisplayIndex(window) : 0;
+    if (display >= 0 && SDL_GetCurrentDisplayMode(display, &mode) == 0 && mode.refresh_rate > 0) {
+        scheduler->frameMs = 1000 / mode.refresh_rate;
+    }
+}
+
+// Safe from any thread; redundant wakes cost one extra pass at most
+void scheduler_wake(void) {
+    if (wakeEvent == (Uint32)-1) {
+        return;
+    }
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = wakeEvent;
+    SDL_PushEvent(&event);
+}
+
+void scheduler_invalidate(Scheduler* scheduler) {
+    scheduler->dirty = true;
+}
+
+void scheduler_animate(Scheduler* scheduler, bool animating) {
+    scheduler->animating = animating;
+    scheduler->dirty = scheduler->dirty || animating;
+}
+
+// Milliseconds left until the next animation frame is due
+static int frame_wait(const Scheduler* scheduler) {
+    Uint64 elapsed = (SDL_GetPerformanceCounter() - scheduler->lastFrame) * 1000 / SDL_GetPerformanceFrequency();
+    return elapsed >= scheduler->frameMs ? 0 : (int)(scheduler->frameMs - elapsed);
+}
+
+// Returns the next event for the screen to handle, false once the queue is
+// empty for this pass. Only the first call of a pass may block: for
+// idleTimeout milliseconds (forever when negative) with nothing to draw,
+// until the next frame while animating, and not at all when dirty.
+bool scheduler_next_event(Scheduler* scheduler, SDL_Event* event, int idleTimeout) {
+    for (;;) {
+        int timeout = 0;
+        if (!scheduler->waited) {
+            if (scheduler->animating) {
+                timeout = frame_wait(scheduler);
+            } else if (!scheduler->dirty) {
+                timeout = idleTimeout;
+            }
+        }
+        scheduler->waited = true;
+
+        int got;
+        if (timeout < 0) {
+            got = SDL_WaitEvent(event);
+        } else if (timeout == 0) {
+            got = SDL_PollEvent(event);
+        } else {
+            got = SDL_WaitEventTimeout(event, timeout);
+        }
+        if (!got) {
+            scheduler->waited = false;
+            return false;
+        }
+        if (event->type == wakeEvent) {
+            scheduler->dirty = true;
+            continue;
+        }
+        if (event->type == SDL_WINDOWEVENT && (event->window.event == SDL_WINDOWEVENT_EXPOSED
+                                               || event->window.event == SDL_WINDOWEVENT_SIZE_CHANGED)) {
+            scheduler->dirty = true;
+        }
+        return true;
+    }
+}
+
+bool scheduler_frame_due(const Scheduler* scheduler) {
+    return scheduler->dirty || scheduler->animating;
+}
+
+void scheduler_frame_done(Scheduler* scheduler) {
+    scheduler->dirty = false;
+    scheduler->lastFrame = SDL_GetPerformanceCounter();
+}
@@ -0,0 +1,32 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+
+// Decides when a screen's loop sleeps and when it draws. While nothing has
+// changed the loop blocks in SDL_WaitEventTimeout, so an idle window costs
+// no CPU and input is handled as soon as it arrives. A change marks the
+// screen dirty and the next pass draws one frame. While an animation runs,
+// frames follow the display's refresh, paced by the vsynced present.
+//
+// Worker threads (analysis, mate search) call scheduler_wake, which posts
+// an event that wakes the loop and marks it dirty.
+
+typedef struct {
+    bool dirty;             // something changed since the last frame
+    bool animating;         // draw every refresh until cleared
+    bool waited;            // this pass has already blocked once
+    Uint32 frameMs;         // refresh interval of the window's display
+    Uint64 lastFrame;       // performance counter at the last present
+} Scheduler;
+
+void scheduler_init(Scheduler* scheduler, SDL_Window* window);
+void scheduler_wake(void);
+void scheduler_invalidate(Scheduler* scheduler);
+void scheduler_animate(Scheduler* scheduler, bool animating);
+bool scheduler_next_event(Scheduler* scheduler, SDL_Event* event, int idleTimeout);
+bool scheduler_frame_due(const Scheduler* scheduler);
+void scheduler_frame_done(Scheduler* scheduler);
+
+#endif
@@ -0,0 +1,759 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <SDL2/SDL.h>
+#include "search.h"
+#include "evaluate.h"
+#include "nnue.h"
+
+// Late move reductions grow with the logarithm of both depth and move number
+static int lmrTable[MAX_PLY][MAX_MOVES];
+static bool lmrInitialized = false;
+
+static void init_lmr_table(void) {
+    if (lmrInitialized) {
+        return;
+    }
+    for (int depth = 1; depth < MAX_PLY; depth++) {
+        for (int moves = 1; moves < MAX_MOVES; moves++) {
+            lmrTable[depth][moves] = (int)(0.75 + log(depth) * log(moves) / 2.25);
+        }
+    }
+    lmrInitialized = true;
+}
+
+void search_default_options(SearchOptions* options) {
+    options->quiescence = true;
+    options->deltaPruning = true;
+    options->seePruning = true;
+    options->nullMove = true;
+    options->lateMoveReductions = true;
+    options->reverseFutility = true;
+    options->futility = true;
+    options->nnue = false;
+    options->tablebases = true;
+}
+
+void search_init(SearchContext* ctx, const Position* pos) {
+    // Another thread may be reading the published stats, so the sequence
+    // is kept odd while the context is cleared, and the clear leaves it be
+    int sequence = SDL_AtomicGet(&ctx->statsSequence) | 1;
+    SDL_AtomicSet(&ctx->statsSequence, sequence);
+    SDL_MemoryBarrierRelease();
+    size_t at = offsetof(SearchContext, statsSequence);
+    size_t after = at + sizeof(ctx->statsSequence);
+    memset(ctx, 0, at);
+    memset((char*)ctx + after, 0, sizeof(*ctx) - after);
+    ctx->pos = *pos;
+    search_default_options(&ctx->options);
+    init_lmr_table();
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&ctx->statsSequence, sequence + 1);
+}
+
+int search_elapsed_ms(const SearchContext* ctx) {
+    uint64_t ticks = SDL_GetPerformanceCounter() - ctx->startCounter;
+    return (int)(ticks * 1000 / SDL_GetPerformanceFrequency());
+}
+
+// Splits the clock into a soft limit, the time a move should normally take,
+// and a hard limit the search stops at no matter what. Without a
+// moves-to-go count the rest of the game is assumed to take 30 moves.
+static void allocate_time(SearchContext* ctx) {
+    const SearchLimits* limits = &ctx->limits;
+    ctx->softLimit = 0;
+    ctx->hardLimit = 0;
+
+    if (limits->time > 0) {
+        int movesToGo = limits->movesToGo > 0 ? (limits->movesToGo < 30 ? limits->movesToGo : 30) : 30;
+        int budget = limits->time - MOVE_OVERHEAD_MS > 1 ? limits->time - MOVE_OVERHEAD_MS : 1;
+        // Never plan on more than half the clock unless the control ends now
+        int cap = movesToGo == 1 ? budget * 9 / 10 : budget / 2;
+        int soft = budget / movesToGo + limits->increment * 3 / 4;
+        ctx->softLimit = soft < cap ? soft : cap;
+        ctx->hardLimit = ctx->softLimit * 4 < cap ? ctx->softLimit * 4 : cap;
+        if (ctx->softLimit < 1) {
+            ctx->softLimit = ctx->hardLimit = 1;
+        }
+    }
+    // A fixed move time is a hard limit only: the search uses all of it
+    if (limits->moveTime > 0 && (ctx->hardLimit == 0 || limits->moveTime < ctx->hardLimit)) {
+        ctx->hardLimit = limits->moveTime;
+        if (ctx->softLimit > ctx->hardLimit) {
+            ctx->softLimit = ctx->hardLimit;
+        }
+    }
+
+    ctx->hardDeadline = 0;
+    if (ctx->hardLimit > 0) {
+        ctx->hardDeadline = ctx->startCounter + (uint64_t)ctx->hardLimit * SDL_GetPerformanceFrequency() / 1000;
+    }
+}
+
+// Copies the counters out for other threads, a seqlock with this thread as
+// the only writer
+static void publish_stats(SearchContext* ctx) {
+    ctx->stats.elapsed = search_elapsed_ms(ctx);
+    SDL_AtomicIncRef(&ctx->statsSequence);
+    SDL_MemoryBarrierRelease();
+    ctx->publishedStats = ctx->stats;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicIncRef(&ctx->statsSequence);
+}
+
+// Retries while the searching thread is in the middle of a copy; the
+// counters themselves are plain integers that only their own thread writes
+void search_read_stats(const SearchContext* ctx, SearchStats* stats) {
+    SDL_atomic_t* sequence = (SDL_atomic_t*)&ctx->statsSequence;
+    for (;;) {
+        int before = SDL_AtomicGet(sequence);
+        if (before & 1) {
+            SDL_CPUPauseInstruction();
+            continue;
+        }
+        SDL_MemoryBarrierAcquire();
+        *stats = ctx->publishedStats;
+        SDL_MemoryBarrierAcquire();
+        if (SDL_AtomicGet(sequence) == before) {
+            return;
+        }
+    }
+}
+
+// Sums the counters of several searches, one per thread or per position.
+// Iteration nodes and times belong to a single search and are left out.
+void search_add_stats(SearchStats* total, const SearchStats* stats) {
+    total->nodes += stats->nodes;
+    total->qnodes += stats->qnodes;
+    total->betaCutoffs += stats->betaCutoffs;
+    total->firstMoveCutoffs += stats->firstMoveCutoffs;
+    total->futilityPrunes += stats->futilityPrunes;
+    total->pawnProbes += stats->pawnProbes;
+    total->pawnHits += stats->pawnHits;
+    total->ttProbes += stats->ttProbes;
+    total->ttHits += stats->ttHits;
+    total->tbHits += stats->tbHits;
+    total->elapsed += stats->elapsed;
+    if (stats->depth > total->depth) {
+        total->depth = stats->depth;
+    }
+}
+
+static void report_progress(SearchContext* ctx) {
+    ctx->report(ctx, ctx->reportData);
+    if (ctx->reportInterval > 0) {
+        ctx->nextReport = SDL_GetPerformanceCounter()
+                        + (uint64_t)ctx->reportInterval * SDL_GetPerformanceFrequency() / 1000;
+    }
+}
+
+static void check_limits(SearchContext* ctx) {
+    // Polled every 4096 nodes so the clock is not read at every node, and
+    // compared in raw counter ticks so no division is needed
+    if ((ctx->stats.nodes & 4095) != 0) {
+        return;
+    }
+    publish_stats(ctx);
+    // A line at a high depth can take seconds; the node count and the lines
+    // found so far go out in between
+    if (ctx->report && ctx->reportInterval > 0 && SDL_GetPerformanceCounter() >= ctx->nextReport) {
+        report_progress(ctx);
+    }
+    if (ctx->limits.nodes && ctx->stats.nodes >= ctx->limits.nodes) {
+        ctx->stopped = true;
+    }
+    if (ctx->hardDeadline && SDL_GetPerformanceCounter() >= ctx->hardDeadline) {
+        ctx->stopped = true;
+    }
+    if (ctx->stopSignal && SDL_AtomicGet(ctx->stopSignal)) {
+        ctx->stopped = true;
+    }
+}
+
+double search_first_move_cutoff_rate(const SearchStats* stats) {
+    return stats->betaCutoffs ? 100.0 * stats->firstMoveCutoffs / stats->betaCutoffs : 0.0;
+}
+
+double search_tt_hit_rate(const SearchStats* stats) {
+    return stats->ttProbes ? 100.0 * stats->ttHits / stats->ttProbes : 0.0;
+}
+
+uint64_t search_nps(const SearchStats* stats) {
+    return stats->elapsed > 0 ? stats->nodes * 1000 / stats->elapsed : 0;
+}
+
+// Geometric mean of the growth in nodes from one iteration to the next,
+// measured from depth 2 so the trivial first iteration does not skew it
+double search_branching_factor(const SearchStats* stats, int depth) {
+    if (depth < 3 || stats->iterationNodes[2] == 0) {
+        return 0.0;
+    }
+    uint64_t first = stats->iterationNodes[2] - stats->iterationNodes[1];
+    uint64_t last = stats->iterationNodes[depth] - stats->iterationNodes[depth - 1];
+    if (first == 0 || last == 0) {
+        return 0.0;
+    }
+    return pow((double)last / first, 1.0 / (depth - 2));
+}
+
+// Ordering bands: transposition table move, previous PV move, captures and
+// promotions by MVV-LVA, killers, countermove, then quiet moves by history
+#define ORDER_HASH 2000000
+#define ORDER_PV 1000000
+#define ORDER_CAPTURE 500000
+#define ORDER_KILLER_1 400000
+#define ORDER_KILLER_2 390000
+#define ORDER_COUNTER 380000
+
+static int piece_rank(char piece) {
+    switch (tolower((unsigned char)piece)) {
+        case 'p': return 1;
+        case 'n': return 2;
+        case 'b': return 3;
+        case 'r': return 4;
+        case 'q': return 5;
+        default: return 6;
+    }
+}
+
+// Most valuable victim first, least valuable attacker breaks ties
+static int mvv_lva(Move move) {
+    int score = (move.captured != ' ') ? piece_rank(move.captured) * 8 : 0;
+    if (move.promotion != ' ') {
+        score += piece_rank(move.promotion) * 8;
+    }
+    return score - piece_rank(move.piece);
+}
+
+static bool is_quiet(Move move) {
+    return move.captured == ' ' && move.promotion == ' ';
+}
+
+static void score_moves(SearchContext* ctx, MoveList* list, int ply, Move hashMove) {
+    int side = ctx->pos.side;
+    Move previous = ctx->moveStack[ply];
+    Move counter = (ply > 0 && !move_is_none(previous)) ? ctx->counterMoves[previous.from][previous.to] : NO_MOVE;
+
+    for (int i = 0; i < list->count; i++) {
+        Move move = list->moves[i];
+        if (move_equals(move, hashMove)) {
+            list->scores[i] = ORDER_HASH;
+        } else if (ply < ctx->previousPvLength && move_equals(move, ctx->previousPv[ply])) {
+            list->scores[i] = ORDER_PV;
+        } else if (!is_quiet(move)) {
+            list->scores[i] = ORDER_CAPTURE + mvv_lva(move);
+        } else if (move_equals(move, ctx->killers[ply][0])) {
+            list->scores[i] = ORDER_KILLER_1;
+        } else if (move_equals(move, ctx->killers[ply][1])) {
+            list->scores[i] = ORDER_KILLER_2;
+        } else if (move_equals(move, counter)) {
+            list->scores[i] = ORDER_COUNTER;
+        } else {
+            list->scores[i] = ctx->history[side][move.from][move.to];
+        }
+    }
+}
+
+// History gravity: entries move towards +-HISTORY_MAX and never overflow
+static void add_history(int* entry, int bonus) {
+    *entry += bonus - *entry * abs(bonus) / HISTORY_MAX;
+}
+
+static void update_quiet_stats(SearchContext* ctx, int ply, int depth, Move best, const Move* tried, int triedCount) {
+    int side = ctx->pos.side;
+    int bonus = depth * depth > 400 ? 400 : depth * depth;
+
+    if (!move_equals(best, ctx->killers[ply][0])) {
+        ctx->killers[ply][1] = ctx->killers[ply][0];
+        ctx->killers[ply][0] = best;
+    }
+    add_history(&ctx->history[side][best.from][best.to], bonus * 32);
+    for (int i = 0; i < triedCount; i++) {
+        add_history(&ctx->history[side][tried[i].from][tried[i].to], -bonus * 32);
+    }
+
+    Move previous = ctx->moveStack[ply];
+    if (ply > 0 && !move_is_none(previous)) {
+        ctx->counterMoves[previous.from][previous.to] = best;
+    }
+}
+
+static int evaluate_node(SearchContext* ctx, int ply) {
+    if (ctx->options.nnue) {
+        return nnue_evaluate(&ctx->accumulators[ply], &ctx->pos);
+    }
+    return evaluate(&ctx->pos, &ctx->pawnTable);
+}
+
+// The network's accumulators follow the search one ply at a time
+static void update_accumulator(SearchContext* ctx, int ply, Move move) {
+    if (ctx->options.nnue) {
+        nnue_update(&ctx->accumulators[ply + 1], &ctx->accumulators[ply], &ctx->pos, move);
+    }
+}
+
+static void pick_move(MoveList* list, int index) {
+    int best = index;
+    for (int i = index + 1; i < list->count; i++) {
+        if (list->scores[i] > list->scores[best]) {
+            best = i;
+        }
+    }
+    if (best != index) {
+        Move move = list->moves[index];
+        int score = list->scores[index];
+        list->moves[index] = list->moves[best];
+        list->scores[index] = list->scores[best];
+        list->moves[best] = move;
+        list->scores[best] = score;
+    }
+}
+
+static void update_pv(SearchContext* ctx, int ply, Move move) {
+    ctx->pv[ply][ply] = move;
+    for (int i = ply + 1; i < ctx->pvLength[ply + 1]; i++) {
+        ctx->pv[ply][i] = ctx->pv[ply + 1][i];
+    }
+    ctx->pvLength[ply] = ctx->pvLength[ply + 1];
+}
+
+// Capture-only search at the leaves. Standing pat on the static evaluation
+// bounds the score from below; captures that cannot reach alpha even with a
+// margin (delta pruning) or that lose material by SEE are not searched.
+// Evasions are searched in full when the side to move is in check.
+static int quiescence(SearchContext* ctx, int alpha, int beta, int ply) {
+    Position* pos = &ctx->pos;
+    ctx->stats.nodes++;
+    ctx->stats.qnodes++;
+    check_limits(ctx);
+    ctx->pvLength[ply] = ply;
+
+    if (ctx->stopped || ply >= MAX_PLY) {
+        return evaluate_node(ctx, ply);
+    }
+
+    bool checked = in_check(pos);
+    int standPat = -SCORE_INFINITE;
+    int best = -SCORE_INFINITE;
+    MoveList list;
+
+    if (!checked) {
+        standPat = evaluate_node(ctx, ply);
+        if (standPat >= beta) {
+            return standPat;
+        }
+        if (standPat > alpha) {
+            alpha = standPat;
+        }
+        best = standPat;
+        generate_moves(pos, &list, true);
+    } else {
+        generate_moves(pos, &list, false);
+    }
+
+    for (int i = 0; i < list.count; i++) {
+        list.scores[i] = mvv_lva(list.moves[i]);
+    }
+
+    int legal = 0;
+    for (int i = 0; i < list.count; i++) {
+        pick_move(&list, i);
+        Move move = list.moves[i];
+
+        if (!checked) {
+            if (ctx->options.deltaPruning && move.promotion == ' '
+                && standPat + piece_value(move.captured) + DELTA_MARGIN <= alpha) {
+                continue;
+            }
+            if (ctx->options.seePruning && see(pos, move) < 0) {
+                continue;
+            }
+        }
+
+        if (!make_move(pos, move)) {
+            continue;
+        }
+        legal++;
+        update_accumulator(ctx, ply, move);
+        int score = -quiescence(ctx, -beta, -alpha, ply + 1);
+        unmake_move(pos, move);
+
+        if (ctx->stopped) {
+            return best;
+        }
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                update_pv(ctx, ply, move);
+                if (score >= beta) {
+                    break;
+                }
+            }
+        }
+    }
+
+    if (checked && legal == 0) {
+        return -SCORE_MATE + ply;
+    }
+    return best;
+}
+
+static bool is_excluded(const SearchContext* ctx, Move move) {
+    for (int i = 0; i < ctx->excludedCount; i++) {
+        if (move_equals(move, ctx->excluded[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int alpha_beta(SearchContext* ctx, int depth, int alpha, int beta, int ply, bool allowNull) {
+    Position* pos = &ctx->pos;
+    ctx->pvLength[ply] = ply;
+
+    if (ply > 0 && is_repetition(pos)) {
+        return 0;
+    }
+
+    bool checked = in_check(pos);
+    if (checked) {
+        depth++;
+    }
+    if (depth <= 0) {
+        if (ctx->options.quiescence) {
+            return quiescence(ctx, alpha, beta, ply);
+        }
+        ctx->stats.nodes++;
+        return evaluate_node(ctx, ply);
+    }
+
+    ctx->stats.nodes++;
+    check_limits(ctx);
+    if (ctx->stopped || ply >= MAX_PLY) {
+        return evaluate_node(ctx, ply);
+    }
+
+    bool pvNode = (beta - alpha > 1);
+    int alphaStart = alpha;
+
+    // A stored result from at least this depth ends the node outright away
+    // from the principal variation; otherwise its move is searched first
+    Move hashMove = NO_MOVE;
+    if (ctx->tt) {
+        ctx->stats.ttProbes++;
+        const TTEntry* entry = tt_probe(ctx->tt, pos->key);
+        if (entry) {
+            ctx->stats.ttHits++;
+            hashMove = entry->move;
+            int ttScore = tt_score(entry, ply);
+            if (!pvNode && ply > 0 && entry->depth >= depth
+                && (entry->bound == TT_BOUND_EXACT
+                    || (entry->bound == TT_BOUND_LOWER && ttScore >= beta)
+                    || (entry->bound == TT_BOUND_UPPER && ttScore <= alpha))) {
+                return ttScore;
+            }
+        }
+    }
+
+    // Positions the endgame tables cover need no search. Mates further away
+    // than MAX_PLY fall below SCORE_MATE_IN_MAX but still order correctly,
+    // and the table stores them relative to the ply like any other mate.
+    if (ctx->options.tablebases && ply > 0) {
+        TablebaseResult tbResult;
+        if (tb_probe(pos, &tbResult)) {
+            ctx->stats.tbHits++;
+            int mateScore = SCORE_MATE - ply - tbResult.plies;
+            return tbResult.wdl > 0 ? mateScore : (tbResult.wdl < 0 ? -mateScore : 0);
+        }
+    }
+
+    int staticEval = checked ? -SCORE_INFINITE : evaluate_node(ctx, ply);
+
+    if (!pvNode && !checked && ply > 0) {
+        // Reverse futility: far enough above beta that a quiet move will not
+        // bring the score back down within the remaining depth
+        if (ctx->options.reverseFutility && depth <= REVERSE_FUTILITY_DEPTH
+            && beta < SCORE_MATE_IN_MAX && staticEval - REVERSE_FUTILITY_MARGIN * depth >= beta) {
+            return staticEval;
+        }
+
+        // Null move: give the opponent a free move and see if we still fail
+        // high. Skipped with pawns only, where zugzwang is common, and verified
+        // with a normal reduced search at high depth.
+        if (ctx->options.nullMove && allowNull && depth >= 3 && staticEval >= beta
+            && has_non_pawn_material(pos, pos->side)) {
+            int reduction = 3 + depth / 4 + ((staticEval - beta) / 200 < 3 ? (staticEval - beta) / 200 : 3);
+            int nullDepth = depth - 1 - reduction;
+
+            make_null_move(pos);
+            ctx->moveStack[ply + 1] = NO_MOVE;
+            if (ctx->options.nnue) {
+                ctx->accumulators[ply + 1] = ctx->accumulators[ply];
+            }
+            int score = -alpha_beta(ctx, nullDepth, -beta, -beta + 1, ply + 1, false);
+            unmake_null_move(pos);
+
+            if (ctx->stopped) {
+                return 0;
+            }
+            if (score >= beta) {
+                // Never return an unproven mate score from a null move search
+                if (score >= SCORE_MATE_IN_MAX) {
+                    score = beta;
+                }
+                if (depth < NULL_MOVE_VERIFY_DEPTH) {
+                    return score;
+                }
+                int verified = alpha_beta(ctx, nullDepth, beta - 1, beta, ply, false);
+                if (verified >= beta) {
+                    return score;
+                }
+            }
+        }
+    }
+
+    MoveList list;
+    generate_moves(pos, &list, false);
+    score_moves(ctx, &list, ply, hashMove);
+
+    bool futile = ctx->options.futility && !pvNode && !checked && depth <= FUTILITY_DEPTH
+        && alpha > -SCORE_MATE_IN_MAX && staticEval + FUTILITY_MARGIN * depth <= alpha;
+
+    Move quietsTried[MAX_MOVES];
+    int quietCount = 0;
+    int best = -SCORE_INFINITE;
+    Move bestMove = NO_MOVE;
+    int legal = 0;
+    for (int i = 0; i < list.count; i++) {
+        pick_move(&list, i);
+        Move move = list.moves[i];
+        if (ply == 0 && is_excluded(ctx, move)) {
+            continue;
+        }
+        if (!make_move(pos, move)) {
+            continue;
+        }
+        legal++;
+        ctx->moveStack[ply + 1] = move;
+
+        bool quiet = is_quiet(move);
+        bool givesCheck = in_check(pos);
+
+        // Futility: a quiet move cannot lift a hopeless static score to alpha
+        if (futile && quiet && !givesCheck && legal > 1) {
+            unmake_move(pos, move);
+            ctx->stats.futilityPrunes++;
+            continue;
+        }
+        update_accumulator(ctx, ply, move);
+
+        int score;
+        if (legal == 1) {
+            score = -alpha_beta(ctx, depth - 1, -beta, -alpha, ply + 1, true);
+        } else {
+            // Late quiet moves are searched shallower with a null window and
+            // re-searched at full depth only if they beat alpha
+            int reduction = 0;
+            if (ctx->options.lateMoveReductions && depth >= 3 && quiet && !checked && !givesCheck
+                && list.scores[i] < ORDER_COUNTER) {
+                reduction = lmrTable[depth < MAX_PLY ? depth : MAX_PLY - 1][legal < MAX_MOVES ? legal : MAX_MOVES - 1];
+                if (pvNode && reduction > 0) {
+                    reduction--;
+                }
+                if (reduction > depth - 2) {
+                    reduction = depth - 2;
+                }
+            }
+
+            score = -alpha_beta(ctx, depth - 1 - reduction, -alpha - 1, -alpha, ply + 1, true);
+            if (reduction > 0 && score > alpha) {
+                score = -alpha_beta(ctx, depth - 1, -alpha - 1, -alpha, ply + 1, true);
+            }
+            if (pvNode && score > alpha && score < beta) {
+                score = -alpha_beta(ctx, depth - 1, -beta, -alpha, ply + 1, true);
+            }
+        }
+        unmake_move(pos, move);
+
+        if (ctx->stopped) {
+            return best;
+        }
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                bestMove = move;
+                update_pv(ctx, ply, move);
+                if (score >= beta) {
+                    ctx->stats.betaCutoffs++;
+                    ctx->stats.firstMoveCutoffs += (legal == 1);
+                    if (quiet) {
+                        update_quiet_stats(ctx, ply, depth, move, quietsTried, quietCount);
+                    }
+                    break;
+                }
+            }
+        }
+        if (quiet) {
+            quietsTried[quietCount++] = move;
+        }
+    }
+
+    if (legal == 0) {
+        return checked ? -SCORE_MATE + ply : 0;
+    }
+
+    // A root searched with moves excluded is not the position's true result
+    if (ctx->tt && !(ply == 0 && ctx->excludedCount > 0)) {
+        int bound = best >= beta ? TT_BOUND_LOWER : best > alphaStart ? TT_BOUND_EXACT : TT_BOUND_UPPER;
+        tt_store(ctx->tt, pos->key, bestMove, best, depth, bound, ply);
+    }
+    return best;
+}
+
+void search_position(SearchContext* ctx, const SearchLimits* limits, SearchResult* result) {
+    ctx->limits = *limits;
+    ctx->stopped = false;
+    ctx->startCounter = SDL_GetPerformanceCounter();
+    ctx->nextReport = ctx->startCounter + (uint64_t)ctx->reportInterval * SDL_GetPerformanceFrequency() / 1000;
+    allocate_time(ctx);
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    ctx->previousPvLength = 0;
+    ctx->moveStack[0] = NO_MOVE;
+    memset(ctx->killers, 0, sizeof(ctx->killers));
+    ctx->pawnTable.probes = 0;
+    ctx->pawnTable.hits = 0;
+
+    // The neural evaluation needs a loaded network and a fresh root accumulator
+    if (ctx->options.nnue && !nnue_loaded()) {
+        ctx->options.nnue = false;
+    }
+    if (ctx->options.nnue) {
+        nnue_refresh(&ctx->accumulators[0], &ctx->pos);
+    }
+    if (tb_max_pieces() == 0) {
+        ctx->options.tablebases = false;
+    }
+
+    memset(result, 0, sizeof(*result));
+    result->bestMove = NO_MOVE;
+    if (ctx->tt) {
+        tt_new_search(ctx->tt);
+    }
+
+    // Fall back to the first legal move if not even depth 1 completes
+    MoveList legal;
+    if (generate_legal_moves(&ctx->pos, &legal) > 0) {
+        result->bestMove = legal.moves[0];
+    }
+
+    int multiPv = limits->multiPv > 1 ? limits->multiPv : 1;
+    if (multiPv > MAX_MULTI_PV) {
+        multiPv = MAX_MULTI_PV;
+    }
+    if (multiPv > legal.count) {
+        multiPv = legal.count;
+    }
+    ctx->lineCount = 0;
+    ctx->excludedCount = 0;
+
+    double bestMoveChanges = 0.0;
+    int stableIterations = 0;
+    int previousScore = 0;
+
+    int maxDepth = (limits->depth > 0 && limits->depth < MAX_PLY) ? limits->depth : MAX_PLY - 1;
+    for (int depth = 1; depth <= maxDepth && legal.count > 0; depth++) {
+        // Each further line excludes the root moves of the lines already
+        // found at this depth. The history, killers and transposition table
+        // carry over from line to line, and each line starts from its own
+        // principal variation of the previous depth.
+        for (int line = 0; line < multiPv; line++) {
+            ctx->excludedCount = line;
+            if (line < ctx->lineCount) {
+                ctx->previousPvLength = ctx->lines[line].pvLength;
+                memcpy(ctx->previousPv, ctx->lines[line].pv, sizeof(Move) * ctx->lines[line].pvLength);
+            } else {
+                ctx->previousPvLength = 0;
+            }
+
+            int score = alpha_beta(ctx, depth, -SCORE_INFINITE, SCORE_INFINITE, 0, true);
+            if (ctx->stopped) {
+                break;
+            }
+
+            SearchResult* found = &ctx->lines[line];
+            found->score = score;
+            found->depth = depth;
+            found->pvLength = ctx->pvLength[0];
+            memcpy(found->pv, ctx->pv[0], sizeof(Move) * ctx->pvLength[0]);
+            found->bestMove = found->pvLength > 0 ? found->pv[0] : NO_MOVE;
+            ctx->excluded[line] = found->bestMove;
+            if (ctx->lineCount <= line) {
+                ctx->lineCount = line + 1;
+            }
+            if (ctx->report) {
+                report_progress(ctx);
+            }
+        }
+        ctx->excludedCount = 0;
+        if (ctx->stopped) {
+            break;
+        }
+        ctx->stats.iterationNodes[depth] = ctx->stats.nodes;
+        ctx->stats.iterationTime[depth] = search_elapsed_ms(ctx);
+        ctx->stats.depth = depth;
+        publish_stats(ctx);
+
+        // Search instability can leave a later line scoring above an earlier one
+        for (int i = 1; i < ctx->lineCount; i++) {
+            SearchResult line = ctx->lines[i];
+            int j = i;
+            for (; j > 0 && ctx->lines[j - 1].score < line.score; j--) {
+                ctx->lines[j] = ctx->lines[j - 1];
+            }
+            ctx->lines[j] = line;
+        }
+
+        bool bestChanged = depth > 1 && !move_equals(ctx->lines[0].bestMove, result->bestMove);
+        *result = ctx->lines[0];
+        if (move_is_none(result->bestMove)) {
+            result->bestMove = legal.moves[0];
+        }
+        ctx->previousPvLength = result->pvLength;
+        memcpy(ctx->previousPv, result->pv, sizeof(Move) * result->pvLength);
+
+        // No point searching deeper once a forced mate has been found
+        if (multiPv == 1 && (result->score >= SCORE_MATE_IN_MAX || result->score <= -SCORE_MATE_IN_MAX)) {
+            break;
+        }
+
+        // On a clock, spend longer while the best move keeps changing or the
+        // score is falling and less once the best move has settled. The next
+        // iteration takes about as long as all earlier ones together, so it
+        // is only started with at least half the scaled budget left.
+        bestMoveChanges = bestMoveChanges / 2 + (bestChanged ? 1.0 : 0.0);
+        stableIterations = bestChanged ? 0 : stableIterations + 1;
+        bool failingLow = depth > 1 && previousScore - result->score > 30;
+        previousScore = result->score;
+        if (ctx->softLimit > 0 && depth >= 4) {
+            double scale = 1.0 + bestMoveChanges;
+            if (failingLow) {
+                scale *= 1.5;
+            }
+            if (stableIterations >= 4) {
+                scale *= 0.5;
+            }
+            if (search_elapsed_ms(ctx) >= ctx->softLimit * scale / 2) {
+                break;
+            }
+        }
+    }
+
+    ctx->stats.pawnProbes = ctx->pawnTable.probes;
+    ctx->stats.pawnHits = ctx->pawnTable.hits;
+    publish_stats(ctx);
+}
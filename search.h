@@ -0,0 +1,138 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "engine.h"
+#include "evaluate.h"
+#include "nnue.h"
+#include "tt.h"
+#include "tb.h"
+#include <SDL2/SDL.h>
+
+// Margin added to the captured piece's value before a capture is skipped by
+// delta pruning in the quiescence search
+#define DELTA_MARGIN 200
+
+// Selective search margins, in centipawns per ply of remaining depth
+#define REVERSE_FUTILITY_DEPTH 6
+#define REVERSE_FUTILITY_MARGIN 90
+#define FUTILITY_DEPTH 3
+#define FUTILITY_MARGIN 120
+#define NULL_MOVE_VERIFY_DEPTH 10
+
+#define MAX_MULTI_PV 8
+
+// Clock time kept back on every move for the GUI and process scheduling
+#define MOVE_OVERHEAD_MS 30
+
+typedef struct {
+    bool quiescence;        // resolve leaves with the capture-only search
+    bool deltaPruning;      // skip captures that cannot raise alpha
+    bool seePruning;        // skip captures that lose material by SEE
+    bool nullMove;          // adaptive null-move pruning
+    bool lateMoveReductions; // logarithmic reductions for late quiet moves
+    bool reverseFutility;   // static eval far above beta returns early
+    bool futility;          // quiet moves skipped when far below alpha
+    bool nnue;              // neural evaluation instead of the hand-written one
+    bool tablebases;        // exact endgame results from the mapped tables
+} SearchOptions;
+
+typedef struct {
+    int depth;              // deepest iteration, 0 for MAX_PLY
+    uint64_t nodes;         // node budget, 0 for none
+    int moveTime;           // milliseconds, 0 for none
+    int multiPv;            // principal variations to keep, 0 or 1 for one
+    int time;               // side to move's clock in milliseconds, 0 for none
+    int increment;          // milliseconds added after each move
+    int movesToGo;          // moves to the next time control, 0 for the rest of the game
+} SearchLimits;
+
+#define HISTORY_MAX 16384
+
+typedef struct {
+    uint64_t nodes;         // every node visited, quiescence nodes included
+    uint64_t qnodes;        // nodes visited by the quiescence search
+    uint64_t betaCutoffs;   // fail-high nodes in the main search
+    uint64_t firstMoveCutoffs; // fail-highs on the first move searched
+    uint64_t futilityPrunes; // quiet moves skipped by futility pruning
+    uint64_t pawnProbes;    // pawn hash lookups by the evaluation
+    uint64_t pawnHits;
+    uint64_t ttProbes;      // transposition table lookups
+    uint64_t ttHits;
+    uint64_t tbHits;        // interior nodes ended by an endgame table
+    uint64_t iterationNodes[MAX_PLY]; // total nodes when each depth completed
+    int iterationTime[MAX_PLY];       // milliseconds when each depth completed
+    int depth;              // deepest completed iteration
+    int elapsed;            // milliseconds searched so far
+} SearchStats;
+
+typedef struct {
+    Move bestMove;
+    int score;
+    int depth;
+    int pvLength;
+    Move pv[MAX_PLY];
+} SearchResult;
+
+struct SearchContext;
+
+// Called from the searching thread each time a principal variation
+// completes, with the lines found so far in ctx->lines, and with
+// reportInterval set also every so often while one is being searched
+typedef void (*SearchReport)(const struct SearchContext* ctx, void* data);
+
+typedef struct SearchContext {
+    Position pos;
+    SearchOptions options;
+    SearchLimits limits;
+    SearchStats stats;
+    bool stopped;
+    uint64_t startCounter;
+    uint64_t hardDeadline;  // performance counter value to stop at, 0 for none
+    int softLimit;          // milliseconds the time manager aims to use, 0 for none
+    int hardLimit;          // milliseconds the search may never exceed
+    int pvLength[MAX_PLY + 1];
+    Move pv[MAX_PLY + 1][MAX_PLY + 1];
+    int previousPvLength;   // principal variation of the last iteration
+    Move previousPv[MAX_PLY];
+
+    // Multi-PV: each line is searched with the root moves of the lines
+    // before it excluded, sharing the tables below with them
+    int lineCount;
+    SearchResult lines[MAX_MULTI_PV];
+    int excludedCount;
+    Move excluded[MAX_MULTI_PV];
+
+    TransTable* tt;         // optional, shared between searches
+    SDL_atomic_t* stopSignal; // optional, set by another thread to stop
+    SearchReport report;    // optional progress callback
+    void* reportData;
+    int reportInterval;     // milliseconds between timed reports, 0 for none
+    uint64_t nextReport;    // performance counter value of the next one
+
+    // Copy of stats refreshed every few thousand nodes for other threads to
+    // read without a lock, see search_read_stats. The sequence is odd while
+    // the copy is being written.
+    SDL_atomic_t statsSequence;
+    SearchStats publishedStats;
+
+    // Move ordering state, one copy per searching thread
+    Move moveStack[MAX_PLY + 1];    // move played to reach each ply
+    Move killers[MAX_PLY + 1][2];   // quiet moves that failed high at this ply
+    int history[2][64][64];         // [side][from][to] quiet move success
+    Move counterMoves[64][64];      // quiet reply to the opponent's [from][to]
+    PawnTable pawnTable;
+    NnueAccumulator accumulators[MAX_PLY + 2];
+} SearchContext;
+
+void search_default_options(SearchOptions* options);
+void search_init(SearchContext* ctx, const Position* pos);
+void search_position(SearchContext* ctx, const SearchLimits* limits, SearchResult* result);
+int search_elapsed_ms(const SearchContext* ctx);
+double search_first_move_cutoff_rate(const SearchStats* stats);
+double search_branching_factor(const SearchStats* stats, int depth);
+double search_tt_hit_rate(const SearchStats* stats);
+uint64_t search_nps(const SearchStats* stats);
+void search_read_stats(const SearchContext* ctx, SearchStats* stats);
+void search_add_stats(SearchStats* total, const SearchStats* stats);
+
+#endif
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "tb.h"
+
+// Order of the pieces after each king, and their weight when deciding which
+// side is the stronger one
+static const char pieceOrder[] = "QRBNP";
+
+static int order_of(char type) {
+    const char* found = strchr(pieceOrder, type);
+    return found ? (int)(found - pieceOrder) : 99;
+}
+
+static int weight_of(char type) {
+    switch (type) {
+        case 'Q': return 9;
+        case 'R': return 5;
+        case 'B': case 'N': return 3;
+        case 'P': return 1;
+        default: return 0;
+    }
+}
+
+// Sorts one side's non-king pieces into table order
+static void sort_side(char* side) {
+    int length = (int)strlen(side);
+    for (int i = 1; i < length; i++) {
+        char piece = side[i];
+        int j = i;
+        for (; j > 0 && order_of(side[j - 1]) > order_of(piece); j--) {
+            side[j] = side[j - 1];
+        }
+        side[j] = piece;
+    }
+}
+
+static int side_weight(const char* side) {
+    int weight = 0;
+    for (; *side; side++) {
+        weight += weight_of(*side);
+    }
+    return weight;
+}
+
+// Builds "K" + first + "K" + second with the stronger side first. Returns
+// true when the sides had to be swapped.
+static bool join_sides(char* first, char* second, char* name) {
+    sort_side(first);
+    sort_side(second);
+    int a = side_weight(first);
+    int b = side_weight(second);
+    bool swap = b > a || (b == a && (strlen(second) > strlen(first)
+                                     || (strlen(second) == strlen(first) && strcmp(second, first) < 0)));
+    sprintf(name, "K%sK%s", swap ? second : first, swap ? first : second);
+    return swap;
+}
+
+// Accepts "KRPKR", "krpkr" or "KRP v KR"; fails on anything that is not
+// two kings with at most TB_MAX_PIECES pieces in total
+bool tb_canonical_name(const char* text, char* name) {
+    char sides[2][TB_MAX_PIECES + 1] = {"", ""};
+    int lengths[2] = {0, 0};
+    int side = -1;
+    int total = 0;
+    for (const char* c = text; *c; c++) {
+        char type = toupper((unsigned char)*c);
+        if (type == 'K') {
+            side++;
+            if (side > 1) {
+                return false;
+            }
+            continue;
+        }
+        if (type == ' ' || type == 'V') {
+            continue;
+        }
+        if (side < 0 || !strchr(pieceOrder, type) || ++total > TB_MAX_PIECES - 2) {
+            return false;
+        }
+        sides[side][lengths[side]++] = type;
+        sides[side][lengths[side]] = '\0';
+    }
+    if (side != 1) {
+        return false;
+    }
+    join_sides(sides[0], sides[1], name);
+    return true;
+}
+
+bool tb_setup(Tablebase* tb, const char* name) {
+    memset(tb, 0, sizeof(*tb));
+    if (!tb_canonical_name(name, tb->name) || strcmp(tb->name, name) != 0) {
+        return false;
+    }
+    tb->pieceCount = (int)strlen(tb->name);
+    tb->strongCount = (int)(strchr(tb->name + 1, 'K') - tb->name);
+    memcpy(tb->pieces, tb->name, tb->pieceCount);
+    tb->pawns = strchr(tb->name, 'P') != NULL;
+    tb->kingSquares = tb->pawns ? 32 : 10;
+    tb->entries = tb->kingSquares;
+    for (int i = 1; i < tb->pieceCount; i++) {
+        tb->entries *= 64;
+    }
+    return true;
+}
+
+// Signature of the material on a board. flipped is set when the uppercase
+// pieces are the strong side.
+void tb_board_name(char board[8][8], char* name, bool* flipped) {
+    char sides[2][17] = {"", ""};
+    int lengths[2] = {0, 0};
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            char piece = board[row][col];
+            if (piece == ' ' || tolower((unsigned char)piece) == 'k') {
+                continue;
+            }
+            int side = piece_side(piece);
+            if (lengths[side] < 16) {
+                sides[side][lengths[side]++] = toupper((unsigned char)piece);
+                sides[side][lengths[side]] = '\0';
+            }
+        }
+    }
+    *flipped = join_sides(sides[SIDE_WHITE], sides[SIDE_BLACK], name);
+}
+
+// The board as the table sees it: the strong side lowercase. Swapping the
+// colours also mirrors the rows so pawns keep moving the right way.
+static char table_piece(char board[8][8], int row, int col, bool flipped) {
+    if (!flipped) {
+        return board[row][col];
+    }
+    char piece = board[7 - row][col];
+    return islower((unsigned char)piece) ? toupper((unsigned char)piece) : tolower((unsigned char)piece);
+}
+
+// Symmetry that brings the strong king into the reduced king squares
+typedef struct {
+    bool flipCol;
+    bool flipRow;
+    bool swap;
+} Symmetry;
+
+static Symmetry symmetry_for(const Tablebase* tb, int kingSq) {
+    Symmetry s = {false, false, false};
+    int row = SQUARE_ROW(kingSq);
+    int col = SQUARE_COL(kingSq);
+    if (col > 3) {
+        s.flipCol = true;
+        col = 7 - col;
+    }
+    if (!tb->pawns) {
+        if (row > 3) {
+            s.flipRow = true;
+            row = 7 - row;
+        }
+        if (col > row) {
+            s.swap = true;
+        }
+    }
+    return s;
+}
+
+static int apply_symmetry(Symmetry s, int sq) {
+    int row = SQUARE_ROW(sq);
+    int col = SQUARE_COL(sq);
+    if (s.flipCol) {
+        col = 7 - col;
+    }
+    if (s.flipRow) {
+        row = 7 - row;
+    }
+    if (s.swap) {
+        int t = row;
+        row = col;
+        col = t;
+    }
+    return SQUARE(row, col);
+}
+
+// Reduced king squares are numbered row by row: col <= row <= 3 without
+// pawns, col <= 3 with them
+static int king_slot(const Tablebase* tb, int sq) {
+    int row = SQUARE_ROW(sq);
+    int col = SQUARE_COL(sq);
+    if (tb->pawns) {
+        return row * 4 + col;
+    }
+    return row * (row + 1) / 2 + col;
+}
+
+static int king_square(const Tablebase* tb, int slot) {
+    if (tb->pawns) {
+        return SQUARE(slot / 4, slot % 4);
+    }
+    int row = 0;
+    while ((row + 1) * (row + 2) / 2 <= slot) {
+        row++;
+    }
+    return SQUARE(row, slot - row * (row + 1) / 2);
+}
+
+uint64_t tb_index(const Tablebase* tb, char board[8][8], bool flipped) {
+    int squares[TB_MAX_PIECES];
+    bool used[TB_MAX_PIECES] = {false};
+    int found = 0;
+
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            char piece = table_piece(board, row, col, flipped);
+            if (piece == ' ') {
+                continue;
+            }
+            int side = piece_side(piece);
+            char type = toupper((unsigned char)piece);
+            int first = side == SIDE_WHITE ? 0 : tb->strongCount;
+            int last = side == SIDE_WHITE ? tb->strongCount : tb->pieceCount;
+            int slot = -1;
+            for (int i = first; i < last; i++) {
+                if (!used[i] && tb->pieces[i] == type) {
+                    slot = i;
+                    break;
+                }
+            }
+            if (slot < 0) {
+                return TB_NO_INDEX;
+            }
+            used[slot] = true;
+            squares[slot] = SQUARE(row, col);
+            found++;
+        }
+    }
+    if (found != tb->pieceCount) {
+        return TB_NO_INDEX;
+    }
+    return tb_index_squares(tb, squares);
+}
+
+// Index of the pieces on squares[], given in table order and orientation
+uint64_t tb_index_squares(const Tablebase* tb, const int* squares) {
+    // With the king on the a1-h8 diagonal the transposed board is the same
+    // position; the first piece off the diagonal decides, as in tb_decode
+    Symmetry s = symmetry_for(tb, squares[0]);
+    int king = apply_symmetry(s, squares[0]);
+    if (!tb->pawns && SQUARE_ROW(king) == SQUARE_COL(king)) {
+        for (int i = 1; i < tb->pieceCount; i++) {
+            int sq = apply_symmetry(s, squares[i]);
+            if (SQUARE_ROW(sq) != SQUARE_COL(sq)) {
+                s.swap = SQUARE_COL(sq) > SQUARE_ROW(sq);
+                break;
+            }
+        }
+    }
+    uint64_t index = king_slot(tb, apply_symmetry(s, squares[0]));
+    for (int i = 1; i < tb->pieceCount; i++) {
+        index = index * 64 + apply_symmetry(s, squares[i]);
+    }
+    return index;
+}
+
+// Places the pieces of an index on a board in table orientation, and their
+// squares in table order when squares is not NULL. Returns false when two
+// pieces share a square, a pawn stands on an end row or the index is the
+// mirror image of another one, which tb_index never produces.
+bool tb_decode(const Tablebase* tb, uint64_t index, char board[8][8], int* squares) {
+    int own[TB_MAX_PIECES];
+    if (!squares) {
+        squares = own;
+    }
+    for (int i = tb->pieceCount - 1; i > 0; i--) {
+        squares[i] = (int)(index % 64);
+        index /= 64;
+    }
+    squares[0] = king_square(tb, (int)index);
+
+    memset(board, ' ', 64);
+    for (int i = 0; i < tb->pieceCount; i++) {
+        int row = SQUARE_ROW(squares[i]);
+        int col = SQUARE_COL(squares[i]);
+        if (board[row][col] != ' ' || (tb->pieces[i] == 'P' && (row == 0 || row == 7))) {
+            return false;
+        }
+        board[row][col] = i < tb->strongCount ? tolower((unsigned char)tb->pieces[i]) : tb->pieces[i];
+    }
+    if (!tb->pawns && SQUARE_ROW(squares[0]) == SQUARE_COL(squares[0])) {
+        for (int i = 1; i < tb->pieceCount; i++) {
+            if (SQUARE_ROW(squares[i]) != SQUARE_COL(squares[i])) {
+                return SQUARE_COL(squares[i]) < SQUARE_ROW(squares[i]);
+            }
+        }
+    }
+    return true;
+}
+
+int tb_plies(int value) {
+    return value - 1;
+}
+
+bool tb_is_win(int value) {
+    return value != TB_DRAW && value != TB_ILLEGAL && (tb_plies(value) & 1);
+}
@@ -0,0 +1,81 @@
+#ifndef TB_H
+#define TB_H
+
+#include "engine.h"
+
+// Endgame tablebases for the game's rules, one file per material signature
+// such as "KQK" or "KRPKR". The stronger side's pieces come first and play
+// as SIDE_WHITE inside the table; a position with the pieces the other way
+// round is looked up with the colours swapped and the board mirrored.
+//
+// Every position has one byte per side to move:
+//   0            draw (or, during generation, not yet resolved)
+//   1 ... 253    plies to mate plus one; odd plies win for the side to
+//                move, even plies (0 = already mated) lose
+//   255          not a legal position
+//
+// Positions are indexed by piece squares after a symmetry reduction on the
+// stronger king: the 10 squares of the a1-d1-d4 triangle without pawns, or
+// the 32 squares of files a-d when pawns fix the board's orientation.
+
+#define TB_MAX_PIECES 5
+#define TB_DRAW 0
+#define TB_ILLEGAL 255
+#define TB_MAX_PLIES 252
+#define TB_NO_INDEX UINT64_MAX
+
+#define TB_MAGIC "CHESSTB1"
+#define TB_HEADER_SIZE 64   // the data starts here, page-offset friendly
+#define TB_EXTENSION ".ctb"
+
+typedef struct {
+    char name[16];          // canonical signature, "KRPKR"
+    int pieceCount;
+    int strongCount;        // the first strongCount pieces are the strong side's
+    char pieces[TB_MAX_PIECES]; // uppercase piece types, each side king first
+    bool pawns;
+    int kingSquares;        // 10 or 32
+    uint64_t entries;       // positions per side to move
+    const uint8_t* data[2]; // [side to move], SIDE_WHITE is the strong side
+} Tablebase;
+
+// On-disk header, followed by data[SIDE_WHITE] and data[SIDE_BLACK]
+typedef struct {
+    char magic[8];
+    char name[16];
+    uint32_t pieceCount;
+    uint32_t kingSquares;
+    uint64_t entries;
+    uint32_t maxPlies;      // longest mate in the table
+    uint32_t reserved[5];
+} TablebaseHeader;
+
+bool tb_canonical_name(const char* text, char* name);
+bool tb_setup(Tablebase* tb, const char* name);
+void tb_board_name(char board[8][8], char* name, bool* flipped);
+uint64_t tb_index(const Tablebase* tb, char board[8][8], bool flipped);
+uint64_t tb_index_squares(const Tablebase* tb, const int* squares);
+bool tb_decode(const Tablebase* tb, uint64_t index, char board[8][8], int* squares);
+int tb_plies(int value);
+bool tb_is_win(int value);
+
+// Result of a probe for the side to move
+typedef struct {
+    int wdl;                // 1 win, 0 draw, -1 loss
+    int plies;              // plies to mate, 0 for a draw or when mated
+} TablebaseResult;
+
+#define TB_DEFAULT_DIR "tables"
+
+// tbprobe.c: tables stay memory-mapped until tb_free or the next tb_init
+int tb_init(const char* dir);
+void tb_free(void);
+int tb_max_pieces(void);
+bool tb_probe(Position* pos, TablebaseResult* result);
+void tb_format_result(const Position* pos, const TablebaseResult* result, char* text, int size);
+
+// tbgen.c: builds <dir>/<NAME>.ctb and every smaller table it depends on
+// that is not already in dir
+bool tb_generate(const char* name, const char* dir, int threads);
+
+#endif
@@ -0,0 +1,478 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <SDL2/SDL.h>
+#include "tb.h"
+
+// Retrograde generation. Iteration n resolves exactly the positions that are
+// decided in n plies: mates at 0, wins at odd n and losses at even n. Only
+// positions whose successors changed in the previous iteration are looked at
+// again, found by walking the moves of those successors backwards.
+//
+// Captures and promotions leave the table. Those successors are read from
+// smaller tables, which are generated first (or loaded when the file is
+// already there), so their values are known from the first iteration on. A
+// result that only they decide is parked in pending until its iteration.
+
+#define TB_MAX_TABLES 64
+#define TB_MAX_THREADS 64
+
+typedef struct {
+    Tablebase tables[TB_MAX_TABLES];
+    uint8_t* buffers[TB_MAX_TABLES];
+    int count;
+    const char* dir;
+    int threads;
+} TablebaseSet;
+
+typedef struct {
+    TablebaseSet* set;
+    Tablebase* tb;
+    uint8_t* values[2];
+    uint8_t* dirty[2];      // a successor was resolved last iteration
+    uint8_t* pending[2];    // iteration decided by other tables, 0 if none
+} Generator;
+
+typedef struct {
+    Generator* gen;
+    Position pos;
+    uint64_t begin;
+    uint64_t end;
+    int iteration;
+    uint64_t resolved;
+    int maxPending;
+} Worker;
+
+static bool generate_table(TablebaseSet* set, const char* name);
+
+static Tablebase* find_table(TablebaseSet* set, const char* name) {
+    for (int i = 0; i < set->count; i++) {
+        if (strcmp(set->tables[i].name, name) == 0) {
+            return &set->tables[i];
+        }
+    }
+    return NULL;
+}
+
+static void table_path(const TablebaseSet* set, const char* name, char* path, int size) {
+    snprintf(path, size, "%s/%s%s", set->dir, name, TB_EXTENSION);
+}
+
+// Reads a finished table into memory; false if there is no usable file
+static bool load_table(TablebaseSet* set, const char* name) {
+    char path[512];
+    table_path(set, name, path, sizeof(path));
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    Tablebase* tb = &set->tables[set->count];
+    TablebaseHeader header;
+    bool ok = tb_setup(tb, name)
+           && fread(&header, sizeof(header), 1, file) == 1
+           && memcmp(header.magic, TB_MAGIC, 8) == 0
+           && strncmp(header.name, name, sizeof(header.name)) == 0
+           && header.entries == tb->entries;
+    uint8_t* data = ok ? malloc(tb->entries * 2) : NULL;
+    ok = data && fread(data, 1, tb->entries * 2, file) == tb->entries * 2;
+    fclose(file);
+    if (!ok) {
+        printf("Ignoring unreadable table %s\n", path);
+        free(data);
+        return false;
+    }
+    tb->data[SIDE_WHITE] = data;
+    tb->data[SIDE_BLACK] = data + tb->entries;
+    set->buffers[set->count++] = data;
+    return true;
+}
+
+static bool write_table(const TablebaseSet* set, const Generator* gen, int maxPlies) {
+    char path[512];
+    table_path(set, gen->tb->name, path, sizeof(path));
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        printf("Error creating %s\n", path);
+        return false;
+    }
+
+    TablebaseHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TB_MAGIC, 8);
+    snprintf(header.name, sizeof(header.name), "%s", gen->tb->name);
+    header.pieceCount = gen->tb->pieceCount;
+    header.kingSquares = gen->tb->kingSquares;
+    header.entries = gen->tb->entries;
+    header.maxPlies = maxPlies;
+
+    uint64_t entries = gen->tb->entries;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+           && fwrite(gen->values[SIDE_WHITE], 1, entries, file) == entries
+           && fwrite(gen->values[SIDE_BLACK], 1, entries, file) == entries;
+    if (fclose(file) != 0 || !ok) {
+        printf("Error writing %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+// Value of a position reached by a capture or a promotion. Bare kings and
+// missing tables count as draws.
+static int external_value(Generator* gen, Position* pos) {
+    char name[32];
+    bool flipped;
+    tb_board_name(pos->board, name, &flipped);
+    if (strcmp(name, "KK") == 0) {
+        return TB_DRAW;
+    }
+    Tablebase* tb = find_table(gen->set, name);
+    if (!tb) {
+        return TB_DRAW;
+    }
+    uint64_t index = tb_index(tb, pos->board, flipped);
+    int side = flipped ? 1 - pos->side : pos->side;
+    return index == TB_NO_INDEX ? TB_DRAW : tb->data[side][index];
+}
+
+// Index after the piece on from moved to to, without scanning a board
+static uint64_t moved_index(const Tablebase* tb, const int* squares, int from, int to) {
+    int moved[TB_MAX_PIECES];
+    for (int i = 0; i < tb->pieceCount; i++) {
+        moved[i] = squares[i] == from ? to : squares[i];
+    }
+    return tb_index_squares(tb, moved);
+}
+
+// Looks at every move of one position. Returns the plies it is decided in
+// with what is known before the given iteration, or -1 if it is not
+// decided yet.
+static int evaluate_entry(Worker* w, int side, uint64_t index) {
+    Generator* gen = w->gen;
+    Position* pos = &w->pos;
+    char board[8][8];
+    int squares[TB_MAX_PIECES];
+    tb_decode(gen->tb, index, board, squares);
+    position_set_board(pos, board, side == SIDE_WHITE ? 'B' : 'W');
+
+    MoveList list;
+    generate_legal_moves(pos, &list);
+    if (list.count == 0) {
+        return in_check(pos) ? 0 : -1;
+    }
+
+    int fastestWin = -1;
+    int slowestLoss = -1;
+    bool allLost = true;
+    for (int i = 0; i < list.count; i++) {
+        Move move = list.moves[i];
+        make_move(pos, move);
+        int value;
+        if (move.captured == ' ' && move.promotion == ' ') {
+            value = gen->values[pos->side][moved_index(gen->tb, squares, move.from, move.to)];
+            // Entries resolved in this iteration by other threads are not
+            // part of what the iteration may use
+            if (value != TB_DRAW && value != TB_ILLEGAL && tb_plies(value) >= w->iteration) {
+                value = TB_DRAW;
+            }
+        } else {
+            value = external_value(gen, pos);
+        }
+        unmake_move(pos, move);
+
+        if (value == TB_DRAW || value == TB_ILLEGAL) {
+            allLost = false;
+        } else if (tb_is_win(value)) {
+            slowestLoss = SDL_max(slowestLoss, tb_plies(value) + 1);
+        } else {
+            allLost = false;
+            int plies = tb_plies(value) + 1;
+            fastestWin = fastestWin < 0 ? plies : SDL_min(fastestWin, plies);
+        }
+    }
+    if (fastestWin >= 0) {
+        return fastestWin;
+    }
+    return allLost ? slowestLoss : -1;
+}
+
+// A position is illegal when the side that just moved is left in check
+static bool entry_is_legal(Worker* w, int side, uint64_t index) {
+    char board[8][8];
+    if (!tb_decode(w->gen->tb, index, board, NULL)) {
+        return false;
+    }
+    position_set_board(&w->pos, board, side == SIDE_WHITE ? 'B' : 'W');
+    return !square_attacked(&w->pos, w->pos.kingSquare[1 - side], side);
+}
+
+static int resolve_range(void* data) {
+    Worker* w = data;
+    Generator* gen = w->gen;
+    int n = w->iteration;
+    for (int side = 0; side < 2; side++) {
+        uint8_t* values = gen->values[side];
+        for (uint64_t i = w->begin; i < w->end; i++) {
+            if (n == 0) {
+                if (!entry_is_legal(w, side, i)) {
+                    values[i] = TB_ILLEGAL;
+                    continue;
+                }
+            } else if (values[i] != TB_DRAW || (!gen->dirty[side][i] && gen->pending[side][i] != n)) {
+                continue;
+            }
+            gen->dirty[side][i] = 0;
+
+            int plies = evaluate_entry(w, side, i);
+            if (plies >= 0 && plies <= n) {
+                values[i] = (uint8_t)(plies + 1);
+                w->resolved++;
+            } else if (plies > n && plies <= TB_MAX_PLIES) {
+                gen->pending[side][i] = (uint8_t)plies;
+                w->maxPending = SDL_max(w->maxPending, plies);
+            }
+        }
+    }
+    return 0;
+}
+
+static void mark_predecessor(Generator* gen, const int* squares, int from, int to, int side) {
+    uint64_t index = moved_index(gen->tb, squares, from, to);
+    if (gen->values[side][index] == TB_DRAW) {
+        gen->dirty[side][index] = 1;
+    }
+}
+
+// Marks every position that reaches a newly resolved one with a move that
+// stays in the table: its mover's pieces stepped backwards onto empty
+// squares. Pieces other than pawns move the same way in both directions.
+static void mark_predecessors(Worker* w, int side, uint64_t index) {
+    Generator* gen = w->gen;
+    Position* pos = &w->pos;
+    int mover = 1 - side;
+    char board[8][8];
+    int squares[TB_MAX_PIECES];
+    tb_decode(gen->tb, index, board, squares);
+    position_set_board(pos, board, mover == SIDE_WHITE ? 'B' : 'W');
+
+    MoveList list;
+    generate_moves(pos, &list, false);
+    for (int i = 0; i < list.count; i++) {
+        Move move = list.moves[i];
+        if (move.captured != ' ' || tolower((unsigned char)move.piece) == 'p') {
+            continue;
+        }
+        mark_predecessor(gen, squares, move.from, move.to, mover);
+    }
+
+    char pawn = mover == SIDE_WHITE ? 'p' : 'P';
+    int back = mover == SIDE_WHITE ? 1 : -1;
+    int startRow = mover == SIDE_WHITE ? 6 : 1;
+    for (int row = 1; row < 7; row++) {
+        for (int col = 0; col < 8; col++) {
+            if (board[row][col] != pawn) {
+                continue;
+            }
+            int from = row + back;
+            if (from < 1 || from > 6 || board[from][col] != ' ') {
+                continue;
+            }
+            mark_predecessor(gen, squares, SQUARE(row, col), SQUARE(from, col), mover);
+            if (from + back == startRow && board[startRow][col] == ' ') {
+                mark_predecessor(gen, squares, SQUARE(row, col), SQUARE(startRow, col), mover);
+            }
+        }
+    }
+}
+
+static int mark_range(void* data) {
+    Worker* w = data;
+    int value = w->iteration + 1;
+    for (int side = 0; side < 2; side++) {
+        const uint8_t* values = w->gen->values[side];
+        for (uint64_t i = w->begin; i < w->end; i++) {
+            if (values[i] == value) {
+                mark_predecessors(w, side, i);
+            }
+        }
+    }
+    return 0;
+}
+
+// Splits the index range over the threads and waits for all of them
+static void run_workers(Worker* workers, int count, SDL_ThreadFunction fn, int iteration) {
+    SDL_Thread* threads[TB_MAX_THREADS];
+    for (int t = 0; t < count; t++) {
+        workers[t].iteration = iteration;
+        workers[t].resolved = 0;
+        threads[t] = count > 1 ? SDL_CreateThread(fn, "tbgen", &workers[t]) : NULL;
+        if (!threads[t]) {
+            fn(&workers[t]);
+        }
+    }
+    for (int t = 0; t < count; t++) {
+        if (threads[t]) {
+            SDL_WaitThread(threads[t], NULL);
+        }
+    }
+}
+
+// Every table one capture or one promotion away
+static bool generate_subtables(TablebaseSet* set, const Tablebase* tb) {
+    for (int i = 0; i < tb->pieceCount; i++) {
+        if (tb->pieces[i] == 'K') {
+            continue;
+        }
+        char sides[2][TB_MAX_PIECES + 2];
+        char variants[3] = {' ', 'Q', 'N'};
+        int count = tb->pieces[i] == 'P' ? 3 : 1;
+        for (int v = 0; v < count; v++) {
+            int lengths[2] = {0, 0};
+            for (int j = 0; j < tb->pieceCount; j++) {
+                int side = j < tb->strongCount ? 0 : 1;
+                char piece = tb->pieces[j];
+                if (j == i) {
+                    if (variants[v] == ' ') {
+                        continue;
+                    }
+                    piece = variants[v];
+                }
+                sides[side][lengths[side]++] = piece;
+            }
+            sides[0][lengths[0]] = '\0';
+            sides[1][lengths[1]] = '\0';
+            char text[TB_MAX_PIECES * 2 + 4];
+            char name[16];
+            snprintf(text, sizeof(text), "%s%s", sides[0], sides[1]);
+            if (!tb_canonical_name(text, name)) {
+                return false;
+            }
+            if (strcmp(name, "KK") != 0 && !generate_table(set, name)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool generate_table(TablebaseSet* set, const char* name) {
+    if (find_table(set, name) || load_table(set, name)) {
+        return true;
+    }
+    if (set->count >= TB_MAX_TABLES) {
+        printf("Too many tables\n");
+        return false;
+    }
+
+    Tablebase* tb = &set->tables[set->count];
+    if (!tb_setup(tb, name)) {
+        printf("Invalid material signature: %s\n", name);
+        return false;
+    }
+    Tablebase own = *tb;
+    if (!generate_subtables(set, &own)) {
+        return false;
+    }
+    tb = &set->tables[set->count];
+    *tb = own;
+
+    uint64_t entries = tb->entries;
+    Generator gen;
+    gen.set = set;
+    gen.tb = tb;
+    uint8_t* buffer = calloc(entries, 6);
+    Worker* workers = calloc(set->threads, sizeof(Worker));
+    if (!buffer || !workers) {
+        printf("Error allocating %llu MB for %s\n", (unsigned long long)(entries * 6 >> 20), name);
+        free(buffer);
+        free(workers);
+        return false;
+    }
+    for (int side = 0; side < 2; side++) {
+        gen.values[side] = buffer + entries * side;
+        gen.dirty[side] = buffer + entries * (2 + side);
+        gen.pending[side] = buffer + entries * (4 + side);
+    }
+
+    uint64_t chunk = (entries + set->threads - 1) / set->threads;
+    for (int t = 0; t < set->threads; t++) {
+        workers[t].gen = &gen;
+        workers[t].begin = SDL_min(entries, chunk * t);
+        workers[t].end = SDL_min(entries, chunk * (t + 1));
+        workers[t].maxPending = 0;
+    }
+
+    printf("Generating %s: %llu positions per side, %d threads\n", name, (unsigned long long)entries, set->threads);
+    uint64_t start = SDL_GetPerformanceCounter();
+    int maxPlies = 0;
+    for (int n = 0; n <= TB_MAX_PLIES; n++) {
+        if (n > 0) {
+            run_workers(workers, set->threads, mark_range, n - 1);
+        }
+        run_workers(workers, set->threads, resolve_range, n);
+
+        uint64_t resolved = 0;
+        int maxPending = 0;
+        for (int t = 0; t < set->threads; t++) {
+            resolved += workers[t].resolved;
+            maxPending = SDL_max(maxPending, workers[t].maxPending);
+        }
+        if (resolved > 0) {
+            maxPlies = n;
+        } else if (maxPending <= n) {
+            break;
+        }
+    }
+
+    uint64_t wins = 0, losses = 0, draws = 0;
+    for (int side = 0; side < 2; side++) {
+        for (uint64_t i = 0; i < entries; i++) {
+            int value = gen.values[side][i];
+            if (value == TB_DRAW) {
+                draws++;
+            } else if (value != TB_ILLEGAL) {
+                tb_is_win(value) ? wins++ : losses++;
+            }
+        }
+    }
+    uint64_t elapsed = (SDL_GetPerformanceCounter() - start) * 1000 / SDL_GetPerformanceFrequency();
+    printf("  %llu wins, %llu losses, %llu draws, longest mate %d plies\n",
+           (unsigned long long)wins, (unsigned long long)losses, (unsigned long long)draws, maxPlies);
+    printf("  %llu ms, %llu KB working memory, %llu KB on disk\n", (unsigned long long)elapsed,
+           (unsigned long long)(entries * 6 >> 10), (unsigned long long)((entries * 2 + TB_HEADER_SIZE) >> 10));
+
+    bool ok = write_table(set, &gen, maxPlies);
+    free(workers);
+    // The values stay in memory for the tables that are built on this one
+    uint8_t* data = realloc(buffer, entries * 2);
+    if (!data) {
+        data = buffer;
+    }
+    tb->data[SIDE_WHITE] = data;
+    tb->data[SIDE_BLACK] = data + entries;
+    set->buffers[set->count++] = data;
+    return ok;
+}
+
+bool tb_generate(const char* name, const char* dir, int threads) {
+    engine_init();
+    char canonical[16];
+    if (!tb_canonical_name(name, canonical)) {
+        printf("Invalid material signature: %s\n", name);
+        return false;
+    }
+
+    TablebaseSet* set = calloc(1, sizeof(TablebaseSet));
+    if (!set) {
+        return false;
+    }
+    set->dir = dir;
+    set->threads = SDL_clamp(threads, 1, TB_MAX_THREADS);
+    bool ok = strcmp(canonical, "KK") == 0 || generate_table(set, canonical);
+    for (int i = 0; i < set->count; i++) {
+        free(set->buffers[i]);
+    }
+    free(set);
+    return ok;
+}
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "tb.h"
+#include "mapfile.h"
+
+// Tables are mapped rather than read into memory: nothing is loaded up front
+// and a probe only touches the page holding its entry.
+
+#define TB_MAX_FILES 256
+#define TB_SLOTS 1024           // material lookup, a power of two
+
+typedef struct {
+    Tablebase tb;
+    uint32_t material;          // material_key with the strong side first
+    MappedFile file;
+} MappedTable;
+
+static MappedTable tables[TB_MAX_FILES];
+static int tableCount = 0;
+static int slots[TB_SLOTS];     // index into tables plus one, 0 when empty
+static int largest = 0;
+
+static const char pieceTypes[] = "QRBNP";
+
+// Two bits per piece type and side; tables hold at most three pieces
+// besides the kings, so no count overflows
+static uint32_t material_key(const int* strong, const int* weak) {
+    uint32_t key = 0;
+    for (int i = 0; i < 5; i++) {
+        key |= (uint32_t)strong[i] << (2 * i);
+        key |= (uint32_t)weak[i] << (10 + 2 * i);
+    }
+    return key;
+}
+
+static int slot_of(uint32_t key) {
+    return (int)((key * 2654435761u) >> 22) & (TB_SLOTS - 1);
+}
+
+static const MappedTable* find_table(uint32_t key) {
+    for (int slot = slot_of(key); slots[slot]; slot = (slot + 1) & (TB_SLOTS - 1)) {
+        const MappedTable* t = &tables[slots[slot] - 1];
+        if (t->material == key) {
+            return t;
+        }
+    }
+    return NULL;
+}
+
+// Maps dir/name.ctb if it is there and matches its header
+static bool open_table(const char* dir, const char* name, uint32_t material) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s%s", dir, name, TB_EXTENSION);
+    MappedTable* t = &tables[tableCount];
+    if (!map_file(&t->file, path, true)) {
+        return false;
+    }
+
+    const TablebaseHeader* header = (const TablebaseHeader*)t->file.data;
+    if (!tb_setup(&t->tb, name) || t->file.size != TB_HEADER_SIZE + 2 * t->tb.entries
+        || memcmp(header->magic, TB_MAGIC, 8) != 0 || strncmp(header->name, name, sizeof(header->name)) != 0) {
+        printf("Ignoring invalid table %s\n", path);
+        unmap_file(&t->file);
+        return false;
+    }
+    t->tb.data[SIDE_WHITE] = t->file.data + TB_HEADER_SIZE;
+    t->tb.data[SIDE_BLACK] = t->file.data + TB_HEADER_SIZE + t->tb.entries;
+    t->material = material;
+
+    int slot = slot_of(material);
+    while (slots[slot]) {
+        slot = (slot + 1) & (TB_SLOTS - 1);
+    }
+    slots[slot] = ++tableCount;
+    if (t->tb.pieceCount > largest) {
+        largest = t->tb.pieceCount;
+    }
+    return true;
+}
+
+// Maps every table in dir, trying each material signature in turn rather
+// than listing the directory. Not safe while another thread is probing.
+int tb_init(const char* dir) {
+    tb_free();
+    for (uint32_t key = 0; key < (1u << 20); key++) {
+        int counts[2][5];
+        int total = 0;
+        char text[2][TB_MAX_PIECES + 1];
+        for (int side = 0; side < 2; side++) {
+            int length = 0;
+            for (int i = 0; i < 5; i++) {
+                counts[side][i] = (key >> (10 * side + 2 * i)) & 3;
+                total += counts[side][i];
+                for (int n = 0; n < counts[side][i] && length < TB_MAX_PIECES; n++) {
+                    text[side][length++] = pieceTypes[i];
+                }
+            }
+            text[side][length] = '\0';
+        }
+        if (total == 0 || total > TB_MAX_PIECES - 2) {
+            continue;
+        }
+
+        // Only the orientation with the strong side first has a file
+        char name[32];
+        char canonical[16];
+        snprintf(name, sizeof(name), "K%sK%s", text[0], text[1]);
+        if (!tb_canonical_name(name, canonical) || strcmp(name, canonical) != 0) {
+            continue;
+        }
+        if (tableCount < TB_MAX_FILES) {
+            open_table(dir, name, key);
+        }
+    }
+    return tableCount;
+}
+
+void tb_free(void) {
+    for (int i = 0; i < tableCount; i++) {
+        unmap_file(&tables[i].file);
+    }
+    memset(slots, 0, sizeof(slots));
+    tableCount = 0;
+    largest = 0;
+}
+
+int tb_max_pieces(void) {
+    return largest;
+}
+
+bool tb_probe(Position* pos, TablebaseResult* result) {
+    if (largest == 0) {
+        return false;
+    }
+
+    // Counting stops as soon as there are more pieces than any table holds,
+    // which keeps the probe cheap away from the endgame
+    static const char emptyRow[8] = {' ', ' ', ' ', ' ', ' ', ' ', ' ', ' '};
+    int counts[2][5] = {{0}};
+    int found[TB_MAX_PIECES];
+    int total = 0;
+    for (int row = 0; row < 8; row++) {
+        if (memcmp(pos->board[row], emptyRow, 8) == 0) {
+            continue;
+        }
+        for (int col = 0; col < 8; col++) {
+            char piece = pos->board[row][col];
+            if (piece == ' ') {
+                continue;
+            }
+            if (total == largest) {
+                return false;
+            }
+            found[total++] = SQUARE(row, col);
+            const char* type = strchr(pieceTypes, toupper((unsigned char)piece));
+            if (type) {
+                counts[piece_side(piece)][type - pieceTypes]++;
+            }
+        }
+    }
+
+    bool flipped = false;
+    const MappedTable* t = find_table(material_key(counts[SIDE_WHITE], counts[SIDE_BLACK]));
+    if (!t) {
+        flipped = true;
+        t = find_table(material_key(counts[SIDE_BLACK], counts[SIDE_WHITE]));
+    }
+    if (!t || total != t->tb.pieceCount) {
+        return false;
+    }
+
+    // Each piece takes the first free slot of its type on its side of the
+    // table; the colours swap and the rows mirror when the table is flipped
+    const Tablebase* tb = &t->tb;
+    int squares[TB_MAX_PIECES];
+    bool used[TB_MAX_PIECES] = {false};
+    for (int i = 0; i < total; i++) {
+        int row = SQUARE_ROW(found[i]);
+        int col = SQUARE_COL(found[i]);
+        char piece = pos->board[row][col];
+        int side = flipped ? 1 - piece_side(piece) : piece_side(piece);
+        char type = toupper((unsigned char)piece);
+        int slot = side == SIDE_WHITE ? 0 : tb->strongCount;
+        while (slot < tb->pieceCount && (used[slot] || tb->pieces[slot] != type)) {
+            slot++;
+        }
+        if (slot == tb->pieceCount) {
+            return false;
+        }
+        used[slot] = true;
+        squares[slot] = flipped ? SQUARE(7 - row, col) : found[i];
+    }
+    uint64_t index = tb_index_squares(tb, squares);
+    int value = tb->data[flipped ? 1 - pos->side : pos->side][index];
+    if (value == TB_ILLEGAL) {
+        return false;
+    }
+    result->wdl = value == TB_DRAW ? 0 : (tb_is_win(value) ? 1 : -1);
+    result->plies = value == TB_DRAW ? 0 : tb_plies(value);
+    return true;
+}
+
+// "White mates in 7" with the colours the board shows, lowercase as White
+void tb_format_result(const Position* pos, const TablebaseResult* result, char* text, int size) {
+    if (result->wdl == 0) {
+        snprintf(text, size, "Tablebase: draw");
+        return;
+    }
+    int winner = result->wdl > 0 ? pos->side : 1 - pos->side;
+    const char* name = winner == SIDE_WHITE ? "White" : "Black";
+    if (result->plies == 0) {
+        snprintf(text, size, "Tablebase: %s has mated", name);
+    } else {
+        snprintf(text, size, "Tablebase: %s mates in %d", name, (result->plies + 1) / 2);
+    }
+}
@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <string.h>
+#include "text.h"
+#include "resources.h"
+
+#define ATLAS_WIDTH 512
+#define BATCH_CHARS 128         // quads per SDL_RenderGeometry call
+
+typedef struct {
+    TTF_Font* font;
+    Uint32 color;
+    char text[TEXT_CACHE_LENGTH];
+    SDL_Texture* texture;
+    int w, h;
+    Uint32 lastUsed;            // for evicting the least recently drawn
+} CachedText;
+
+static GlyphAtlas atlases[TEXT_MAX_ATLASES];
+static int atlasCount = 0;
+static CachedText cache[TEXT_CACHE_SIZE];
+static Uint32 cacheClock = 0;
+
+// Renders every glyph once and packs them row by row into one texture
+static bool build_atlas(SDL_Renderer* renderer, TTF_Font* font, GlyphAtlas* atlas) {
+    SDL_Color white = {255, 255, 255, 255};
+    SDL_Surface* glyphs[TEXT_CHAR_COUNT] = {NULL};
+    int height = TTF_FontHeight(font);
+    int x = 0, y = 0;
+
+    for (int i = 0; i < TEXT_CHAR_COUNT; i++) {
+        char text[2] = {(char)(TEXT_FIRST_CHAR + i), '\0'};
+        int minX, maxX, minY, maxY, advance;
+        if (TTF_GlyphMetrics(font, (Uint16)text[0], &minX, &maxX, &minY, &maxY, &advance) != 0) {
+            advance = 0;
+        }
+        // A space renders as an empty surface on some versions of SDL_ttf
+        glyphs[i] = text[0] == ' ' ? NULL : TTF_RenderText_Blended(font, text, white);
+        int w = glyphs[i] ? glyphs[i]->w : advance;
+        if (x + w > ATLAS_WIDTH) {
+            x = 0;
+            y += height;
+        }
+        atlas->glyphs[i].source = (SDL_Rect){x, y, w, height};
+        atlas->glyphs[i].advance = advance;
+        x += w + 1;
+    }
+
+    SDL_Surface* sheet = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_WIDTH, y + height, 32, SDL_PIXELFORMAT_ARGB8888);
+    bool ok = sheet != NULL;
+    if (ok) {
+        SDL_FillRect(sheet, NULL, 0);
+        for (int i = 0; i < TEXT_CHAR_COUNT; i++) {
+            if (glyphs[i]) {
+                // Copy the alpha as it is instead of blending onto the sheet
+                SDL_SetSurfaceBlendMode(glyphs[i], SDL_BLENDMODE_NONE);
+                SDL_Rect dst = atlas->glyphs[i].source;
+                SDL_BlitSurface(glyphs[i], NULL, sheet, &dst);
+            }
+        }
+        atlas->texture = resource_texture_from_surface(renderer, sheet, "glyph atlas");
+        ok = atlas->texture != NULL;
+    }
+    if (!ok) {
+        printf("Error building the glyph atlas: %s\n", SDL_GetError());
+    } else {
+        SDL_SetTextureBlendMode(atlas->texture, SDL_BLENDMODE_BLEND);
+    }
+
+    for (int i = 0; i < TEXT_CHAR_COUNT; i++) {
+        SDL_FreeSurface(glyphs[i]);
+    }
+    SDL_FreeSurface(sheet);
+    atlas->font = font;
+    atlas->height = height;
+    return ok;
+}
+
+// The atlas for a font, built the first time the font is drawn with
+GlyphAtlas* text_atlas(SDL_Renderer* renderer, TTF_Font* font) {
+    for (int i = 0; i < atlasCount; i++) {
+        if (atlases[i].font == font) {
+            return atlases[i].texture ? &atlases[i] : NULL;
+        }
+    }
+    if (atlasCount == TEXT_MAX_ATLASES) {
+        return NULL;
+    }
+    GlyphAtlas* atlas = &atlases[atlasCount++];
+    build_atlas(renderer, font, atlas);
+    return atlas->texture ? atlas : NULL;
+}
+
+static const Glyph* glyph_of(const GlyphAtlas* atlas, char c) {
+    int index = (unsigned char)c - TEXT_FIRST_CHAR;
+    if (index < 0 || index >= TEXT_CHAR_COUNT) {
+        index = '?' - TEXT_FIRST_CHAR;
+    }
+    return &atlas->glyphs[index];
+}
+
+void text_draw(SDL_Renderer* renderer, TTF_Font* font, const char* text, int x, int y, SDL_Color color) {
+    GlyphAtlas* atlas = text_atlas(renderer, font);
+    if (!atlas) {
+        return;
+    }
+    int textureW, textureH;
+    SDL_QueryTexture(atlas->texture, NULL, NULL, &textureW, &textureH);
+
+    // Two triangles per glyph, tinted by the vertex colour
+    SDL_Vertex vertices[BATCH_CHARS * 4];
+    int indices[BATCH_CHARS * 6];
+    int quads = 0;
+    float penX = (float)x;
+    for (const char* c = text; ; c++) {
+        if (*c == '\0' || quads == BATCH_CHARS) {
+            if (quads > 0) {
+                SDL_RenderGeometry(renderer, atlas->texture, vertices, quads * 4, indices, quads * 6);
+            }
+            quads = 0;
+            if (*c == '\0') {
+                break;
+            }
+        }
+        const Glyph* glyph = glyph_of(atlas, *c);
+        if (*c != ' ' && glyph->source.w > 0) {
+            float left = penX, top = (float)y;
+            float right = left + glyph->source.w, bottom = top + glyph->source.h;
+            float u0 = (float)glyph->source.x / textureW, v0 = (float)glyph->source.y / textureH;
+            float u1 = (float)(glyph->source.x + glyph->source.w) / textureW;
+            float v1 = (float)(glyph->source.y + glyph->source.h) / textureH;
+            SDL_Vertex* v = &vertices[quads * 4];
+            v[0] = (SDL_Vertex){{left, top}, color, {u0, v0}};
+            v[1] = (SDL_Vertex){{right, top}, color, {u1, v0}};
+            v[2] = (SDL_Vertex){{right, bottom}, color, {u1, v1}};
+            v[3] = (SDL_Vertex){{left, bottom}, color, {u0, v1}};
+            int* index = &indices[quads * 6];
+            int base = quads * 4;
+            index[0] = base;
+            index[1] = base + 1;
+            index[2] = base + 2;
+            index[3] = base;
+            index[4] = base + 2;
+            index[5] = base + 3;
+            quads++;
+        }
+        penX += glyph->advance;
+    }
+}
+
+int text_width(SDL_Renderer* renderer, TTF_Font* font, const char* text) {
+    GlyphAtlas* atlas = text_atlas(renderer, font);
+    int width = 0;
+    for (const char* c = text; atlas && *c; c++) {
+        width += glyph_of(atlas, *c)->advance;
+    }
+    return width;
+}
+
+static Uint32 pack_color(SDL_Color color) {
+    return (Uint32)color.r << 24 | (Uint32)color.g << 16 | (Uint32)color.b << 8 | color.a;
+}
+
+// Draws a whole-string texture, rendering it on a miss over the entry drawn
+// longest ago. Strings too long for the cache go through the atlas.
+void text_draw_cached(SDL_Renderer* renderer, TTF_Font* font, const char* text, int x, int y, SDL_Color color) {
+    if (strlen(text) >= TEXT_CACHE_LENGTH) {
+        text_draw(renderer, font, text, x, y, color);
+        return;
+    }
+    Uint32 key = pack_color(color);
+    CachedText* entry = NULL;
+    CachedText* oldest = &cache[0];
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+        if (cache[i].texture && cache[i].font == font && cache[i].color == key && strcmp(cache[i].text, text) == 0) {
+            entry = &cache[i];
+            break;
+        }
+        if (!cache[i].texture || (oldest->texture && cache[i].lastUsed < oldest->lastUsed)) {
+            oldest = &cache[i];
+        }
+    }
+
+    if (!entry) {
+        SDL_Surface* surface = TTF_RenderText_Blended(font, text, color);
+        SDL_Texture* texture = resource_texture_from_surface(renderer, surface, text);
+        if (!texture) {
+            SDL_FreeSurface(surface);
+            text_draw(renderer, font, text, x, y, color);
+            return;
+        }
+        resource_release(oldest->texture);
+        entry = oldest;
+        entry->font = font;
+        entry->color = key;
+        snprintf(entry->text, sizeof(entry->text), "%s", text);
+        entry->texture = texture;
+        entry->w = surface->w;
+        entry->h = surface->h;
+        SDL_FreeSurface(surface);
+    }
+    entry->lastUsed = ++cacheClock;
+    SDL_Rect dst = {x, y, entry->w, entry->h};
+    SDL_RenderCopy(renderer, entry->texture, NULL, &dst);
+}
+
+// Drops the atlas and cached strings of a font that is about to be closed,
+// so a font opened later at the same address does not find them
+void text_forget_font(TTF_Font* font) {
+    for (int i = 0; i < atlasCount; i++) {
+        if (atlases[i].font == font) {
+            resource_release(atlases[i].texture);
+            atlases[i] = atlases[--atlasCount];
+            memset(&atlases[atlasCount], 0, sizeof(GlyphAtlas));
+            break;
+        }
+    }
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+        if (cache[i].font == font) {
+            resource_release(cache[i].texture);
+            memset(&cache[i], 0, sizeof(CachedText));
+        }
+    }
+}
+
+// Destroys the atlases and cached strings; call before the renderer goes
+void text_free(void) {
+    for (int i = 0; i < atlasCount; i++) {
+        resource_release(atlases[i].texture);
+    }
+    memset(atlases, 0, sizeof(atlases));
+    atlasCount = 0;
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+        resource_release(cache[i].texture);
+    }
+    memset(cache, 0, sizeof(cache));
+}
@@ -0,0 +1,39 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+// Text drawing without SDL_ttf in the frame loop. Each font's printable
+// ASCII glyphs are rasterized once into an atlas texture, in white, and a
+// string is drawn as one batch of textured quads tinted to its colour.
+// Fixed strings such as the turn label can instead be kept whole in a small
+// cache keyed by font, colour and text, which keeps their kerning.
+
+#define TEXT_FIRST_CHAR 32
+#define TEXT_CHAR_COUNT 95      // ' ' to '~'; anything else draws as '?'
+#define TEXT_MAX_ATLASES 8
+#define TEXT_CACHE_SIZE 32
+#define TEXT_CACHE_LENGTH 64    // longer strings are not cached
+
+typedef struct {
+    SDL_Rect source;            // in the atlas, the full line height
+    int advance;
+} Glyph;
+
+typedef struct {
+    TTF_Font* font;
+    SDL_Texture* texture;
+    int height;
+    Glyph glyphs[TEXT_CHAR_COUNT];
+} GlyphAtlas;
+
+GlyphAtlas* text_atlas(SDL_Renderer* renderer, TTF_Font* font);
+void text_draw(SDL_Renderer* renderer, TTF_Font* font, const char* text, int x, int y, SDL_Color color);
+void text_draw_cached(SDL_Renderer* renderer, TTF_Font* font, const char* text, int x, int y, SDL_Color color);
+int text_width(SDL_Renderer* renderer, TTF_Font* font, const char* text);
+void text_forget_font(TTF_Font* font);
+void text_free(void);
+
+#endif
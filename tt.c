@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tt.h"
+
+bool tt_init(TransTable* tt, int megabytes) {
+    // Largest power of two number of entries that fits in the budget
+    uint64_t count = 1;
+    while (count * 2 * sizeof(TTEntry) <= (uint64_t)megabytes * 1024 * 1024) {
+        count *= 2;
+    }
+
+    tt->entries = calloc(count, sizeof(TTEntry));
+    if (!tt->entries) {
+        printf("Error allocating a %d MB transposition table\n", megabytes);
+        tt->mask = 0;
+        return false;
+    }
+    tt->mask = count - 1;
+    tt->generation = 0;
+    return true;
+}
+
+void tt_free(TransTable* tt) {
+    free(tt->entries);
+    tt->entries = NULL;
+    tt->mask = 0;
+}
+
+void tt_clear(TransTable* tt) {
+    if (tt->entries) {
+        memset(tt->entries, 0, sizeof(TTEntry) * (tt->mask + 1));
+    }
+    tt->generation = 0;
+}
+
+// Entries from earlier searches stay usable but are replaced first
+void tt_new_search(TransTable* tt) {
+    tt->generation++;
+}
+
+const TTEntry* tt_probe(const TransTable* tt, uint64_t key) {
+    if (!tt->entries) {
+        return NULL;
+    }
+    const TTEntry* entry = &tt->entries[key & tt->mask];
+    return (entry->key == key && entry->bound != TT_BOUND_NONE) ? entry : NULL;
+}
+
+void tt_store(TransTable* tt, uint64_t key, Move move, int score, int depth, int bound, int ply) {
+    if (!tt->entries) {
+        return;
+    }
+    TTEntry* entry = &tt->entries[key & tt->mask];
+
+    // Keep a deeper result for the same position or from the current search
+    // unless the new one is exact
+    if (entry->bound != TT_BOUND_NONE && entry->generation == tt->generation && bound != TT_BOUND_EXACT
+        && depth < entry->depth) {
+        return;
+    }
+    // A bound without a move keeps the move found by an earlier search
+    if (move_is_none(move) && entry->key == key) {
+        move = entry->move;
+    }
+
+    if (score >= SCORE_TB_MATE_IN_MAX) {
+        score += ply;
+    } else if (score <= -SCORE_TB_MATE_IN_MAX) {
+        score -= ply;
+    }
+
+    entry->key = key;
+    entry->move = move;
+    entry->depth = depth;
+    entry->bound = bound;
+    entry->generation = tt->generation;
+    entry->score = score;
+}
+
+// Converts a stored score back to the distance from the root at this ply
+int tt_score(const TTEntry* entry, int ply) {
+    int score = entry->score;
+    if (score >= SCORE_TB_MATE_IN_MAX) {
+        return score - ply;
+    }
+    if (score <= -SCORE_TB_MATE_IN_MAX) {
+        return score + ply;
+    }
+    return score;
+}
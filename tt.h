@@ -0,0 +1,41 @@
+#ifndef TT_H
+#define TT_H
+
+#include "engine.h"
+
+#define TT_DEFAULT_MB 32
+
+#define TT_BOUND_NONE 0
+#define TT_BOUND_UPPER 1    // fail low, the score is at most this
+#define TT_BOUND_LOWER 2    // fail high, the score is at least this
+#define TT_BOUND_EXACT 3
+
+// One stored search result. Mate scores, endgame-table mates included, are
+// kept relative to the entry's own position so they stay correct when
+// reached at another ply.
+typedef struct {
+    uint64_t key;
+    Move move;
+    signed char depth;
+    unsigned char bound;
+    unsigned char generation;
+    short score;
+} TTEntry;
+
+// Shared by every search that is handed a pointer to it, so consecutive
+// searches and the lines of a multi-PV search build on each other
+typedef struct {
+    TTEntry* entries;
+    uint64_t mask;          // entry count minus one, a power of two
+    unsigned char generation;
+} TransTable;
+
+bool tt_init(TransTable* tt, int megabytes);
+void tt_free(TransTable* tt);
+void tt_clear(TransTable* tt);
+void tt_new_search(TransTable* tt);
+const TTEntry* tt_probe(const TransTable* tt, uint64_t key);
+void tt_store(TransTable* tt, uint64_t key, Move move, int score, int depth, int bound, int ply);
+int tt_score(const TTEntry* entry, int ply);
+
+#endif